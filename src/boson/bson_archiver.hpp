@@ -339,6 +339,18 @@ class BSONOutputArchive : public cereal::OutputArchive<BSONOutputArchive> {
         _bsonBuilder.append(bsoncxx::types::b_date{tp});
     }
 
+    /**
+     * Saves a BSON value exactly as it was read from another document. This is used by types that
+     * defer deserialization, so that data that was never decoded can be written back by copying
+     * its original bytes.
+     *
+     * @param value
+     *    The value to append. It is copied into the document being built.
+     */
+    void saveRawValue(const bsoncxx::types::value& value) {
+        _bsonBuilder.append(value);
+    }
+
     /**
      * Write the name of the upcoming element and prepare object/array state.
      * Since writeName is called for every value that is output, regardless of
@@ -551,6 +563,7 @@ class BSONInputArchive : public cereal::InputArchive<BSONInputArchive> {
             // Reset _nextName
             const char* nextName = _nextName;
             _nextName = nullptr;
+            _lastSearchedName = nextName;
 
             if (_nodeTypeStack.top() == InputNodeType::InObject ||
                 _nodeTypeStack.top() == InputNodeType::InRootElement) {
@@ -580,6 +593,7 @@ class BSONInputArchive : public cereal::InputArchive<BSONInputArchive> {
             // If we're in an array (InEmbeddedArray), retrieve an element from
             // the array iterator at the top of the stack, and increment it for
             // the next retrieval.
+            _lastSearchedName = nullptr;
             auto& iter = _embeddedBsonArrayIteratorStack.top();
             const auto elemFromArr = *iter;
             ++iter;
@@ -624,6 +638,7 @@ class BSONInputArchive : public cereal::InputArchive<BSONInputArchive> {
         if (_nextName) {
             const char* nextName = _nextName;
             _nextName = nullptr;
+            _lastSearchedName = nextName;
 
             bsoncxx::document::element val{};
 
@@ -894,6 +909,31 @@ class BSONInputArchive : public cereal::InputArchive<BSONInputArchive> {
         }
     }
 
+    /**
+     * Loads the next element as a raw BSON value without deserializing it. This is used by types
+     * that defer deserialization until their data is first accessed.
+     *
+     * @param owner
+     *    Set to a pointer that shares ownership of the document the returned value points into.
+     *    The value remains valid for as long as a copy of this pointer is kept alive.
+     *
+     * @return The value of the element with the current name, or the next element of the current
+     *         array.
+     */
+    bsoncxx::types::value loadRawValue(std::shared_ptr<uint8_t>& owner) {
+        auto val = search();
+        owner = _curBsonData;
+        return val;
+    }
+
+    /**
+     * Returns the key of the element most recently searched for, or nullptr if it was an array
+     * element. The returned pointer is only valid for as long as the name passed to setNextName().
+     */
+    const char* lastSearchedName() const {
+        return _lastSearchedName;
+    }
+
    private:
     // The key name of the next element being searched.
     const char* _nextName;
@@ -904,6 +944,9 @@ class BSONInputArchive : public cereal::InputArchive<BSONInputArchive> {
     // Bool that tracks whether or not a document has been read from the stream.
     bool _readFirstDoc;
 
+    // The key of the element most recently searched for.
+    const char* _lastSearchedName = nullptr;
+
     // Cache for the next search result if willSearchYieldValue() returns true.
     stdx::optional<bsoncxx::types::value> _cachedSearchResult;
 
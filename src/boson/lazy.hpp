@@ -0,0 +1,291 @@
+// Copyright 2016 MongoDB Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <boson/config/prelude.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include <bsoncxx/builder/core.hpp>
+#include <bsoncxx/types/value.hpp>
+
+#include <boson/bson_archiver.hpp>
+#include <boson/mapping_functions.hpp>
+#include <boson/stdx/optional.hpp>
+
+namespace boson {
+BOSON_INLINE_NAMESPACE_BEGIN
+
+namespace details {
+
+/**
+ * Wraps a value so that it can be deserialized from a single-element document.
+ */
+template <class T>
+struct raw_value_holder {
+    T value;
+
+    template <class Archive>
+    void serialize(Archive& ar) {
+        ar(cereal::make_nvp("v", value));
+    }
+};
+
+/**
+ * Deserializes a raw BSON value into an object of type T.
+ */
+template <class T>
+T decode_raw_value(const bsoncxx::types::value& value) {
+    auto builder = bsoncxx::builder::core(false);
+    builder.key_view("v");
+    builder.append(value);
+
+    raw_value_holder<T> holder{};
+    to_obj(builder.view_document(), holder);
+    return std::move(holder.value);
+}
+
+}  // namespace details
+
+/**
+ * Receives notifications about fields whose deserialization is deferred, such as lazy<T>. This is
+ * used to find out which of the fields that are fetched from the database are actually read.
+ */
+class field_observer {
+   public:
+    virtual ~field_observer() = default;
+
+    /**
+     * Called when a deferred field is loaded, before it is decoded.
+     */
+    virtual void field_loaded(const std::string& name) = 0;
+
+    /**
+     * Called when a deferred field that was loaded while this observer was installed is decoded
+     * for the first time.
+     */
+    virtual void field_accessed(const std::string& name) = 0;
+};
+
+/**
+ * Returns the observer that is notified about the deferred fields loaded on the calling thread.
+ * Deferred fields keep a reference to the observer that was installed when they were loaded, so
+ * the observer may be replaced or reset as soon as loading is done.
+ */
+inline std::shared_ptr<field_observer>& current_field_observer() {
+    static thread_local std::shared_ptr<field_observer> observer;
+    return observer;
+}
+
+namespace details {
+
+/**
+ * Registers a deferred field that is being loaded from an archive with the current field
+ * observer, if there is one.
+ *
+ * @return The observer to notify once the field is decoded, or nullptr.
+ */
+inline std::shared_ptr<field_observer> observe_field_load(const BSONInputArchive& ar,
+                                                          std::string& name) {
+    const auto& observer = current_field_observer();
+    if (observer && ar.lastSearchedName()) {
+        name = ar.lastSearchedName();
+        observer->field_loaded(name);
+        return observer;
+    }
+    return nullptr;
+}
+
+}  // namespace details
+
+/**
+ * A field wrapper that defers deserialization of its value until it is first accessed.
+ *
+ * When a lazy<T> is loaded by a BSONInputArchive, it only keeps a view of the field's bytes,
+ * together with a reference to the document that owns them, in the same way that classes inheriting
+ * UnderlyingBSONDataBase do. The value is decoded the first time it is accessed. A lazy<T> that was
+ * never accessed is saved by copying the original bytes, so large embedded documents or arrays that
+ * are read and written back unchanged are never decoded at all.
+ *
+ * Note that accessing the value of a const lazy<T> modifies its internal state, so a lazy<T> must
+ * not be accessed concurrently from multiple threads until it has been decoded.
+ *
+ * @tparam T A default-constructible type that is serializable using a BSONArchiver.
+ */
+template <class T>
+class lazy {
+    static_assert(std::is_default_constructible<T>::value,
+                  "Template type must be default constructible");
+
+   public:
+    using value_type = T;
+
+    /**
+     * Constructs a lazy<T> holding a default-constructed value.
+     */
+    lazy() : _value(T{}) {
+    }
+
+    /**
+     * Constructs a lazy<T> holding the given value.
+     */
+    lazy(T value) : _value(std::move(value)) {
+    }
+
+    lazy& operator=(T value) {
+        _value = std::move(value);
+        release_raw();
+        return *this;
+    }
+
+    /**
+     * Returns the value, decoding it first if it hasn't been accessed yet.
+     *
+     * @throws boson::Exception if the stored BSON cannot be deserialized into a T.
+     */
+    const T& get() const {
+        decode();
+        return *_value;
+    }
+
+    /**
+     * Returns the value, decoding it first if it hasn't been accessed yet. Since the value may be
+     * modified through the returned reference, it will be re-encoded when saved.
+     *
+     * @throws boson::Exception if the stored BSON cannot be deserialized into a T.
+     */
+    T& get() {
+        decode();
+        return *_value;
+    }
+
+    const T& operator*() const {
+        return get();
+    }
+
+    T& operator*() {
+        return get();
+    }
+
+    const T* operator->() const {
+        return &get();
+    }
+
+    T* operator->() {
+        return &get();
+    }
+
+    /**
+     * Returns true if the value has been decoded or assigned, and false if it is still held as
+     * raw BSON.
+     */
+    bool is_decoded() const {
+        return static_cast<bool>(_value);
+    }
+
+    /**
+     * Loads the current element from the archive without decoding it.
+     */
+    void load_from(BSONInputArchive& ar) {
+        _raw = ar.loadRawValue(_owner);
+        _value = stdx::nullopt;
+        _observer = details::observe_field_load(ar, _name);
+    }
+
+    /**
+     * Saves the value to the archive, copying the original bytes if it was never decoded.
+     */
+    void save_to(BSONOutputArchive& ar) const {
+        if (_value) {
+            ar(*_value);
+            return;
+        }
+
+        ar.writeName();
+        ar.saveRawValue(*_raw);
+        ar.writeDocIfRoot();
+    }
+
+   private:
+    void decode() const {
+        if (!_value) {
+            _value = details::decode_raw_value<T>(*_raw);
+            release_raw();
+
+            if (_observer) {
+                _observer->field_accessed(_name);
+                _observer.reset();
+            }
+        }
+    }
+
+    void release_raw() const {
+        _raw = stdx::nullopt;
+        _owner.reset();
+    }
+
+    // The decoded value, or an empty optional if the value is still held as raw BSON.
+    mutable stdx::optional<T> _value;
+
+    // The raw value that has not been decoded yet, and the document data that it points into.
+    mutable stdx::optional<bsoncxx::types::value> _raw;
+    mutable std::shared_ptr<uint8_t> _owner;
+
+    // The observer to notify when the value is first decoded, and the name of this field.
+    mutable std::shared_ptr<field_observer> _observer;
+    std::string _name;
+};
+
+// ######################################################################
+// Prologue and epilogue for lazy<T>. Like BSON types, a lazy field is a single element, so it
+// does not start or finish nodes. When saving a decoded value, the value itself starts a node if
+// it needs one.
+
+template <class T>
+inline void prologue(BSONOutputArchive&, lazy<T> const&) {
+}
+
+template <class T>
+inline void epilogue(BSONOutputArchive&, lazy<T> const&) {
+}
+
+template <class T>
+inline void prologue(BSONInputArchive&, lazy<T> const&) {
+}
+
+template <class T>
+inline void epilogue(BSONInputArchive&, lazy<T> const&) {
+}
+
+// Saving lazy<T> to BSON
+template <class T>
+inline void CEREAL_SAVE_FUNCTION_NAME(BSONOutputArchive& ar, lazy<T> const& t) {
+    t.save_to(ar);
+}
+
+// Loading lazy<T> from BSON
+template <class T>
+inline void CEREAL_LOAD_FUNCTION_NAME(BSONInputArchive& ar, lazy<T>& t) {
+    t.load_from(ar);
+}
+
+BOSON_INLINE_NAMESPACE_END
+}  // namespace boson
+
+#include <boson/config/postlude.hpp>
@@ -0,0 +1,322 @@
+// Copyright 2016 MongoDB Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <boson/config/prelude.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <bsoncxx/array/view.hpp>
+#include <bsoncxx/document/view.hpp>
+#include <bsoncxx/types.hpp>
+#include <bsoncxx/types/value.hpp>
+
+#include <boson/bson_archiver.hpp>
+#include <boson/lazy.hpp>
+#include <boson/mapping_functions.hpp>
+
+namespace boson {
+BOSON_INLINE_NAMESPACE_BEGIN
+
+namespace details {
+
+/**
+ * Deserializes a single raw BSON element into an object of type T.
+ *
+ * @param element
+ *   Points to the first byte of the element, i.e. its type.
+ * @param length
+ *   The length of the element in bytes, including its type and key.
+ */
+template <class T>
+T decode_raw_element(const std::uint8_t* element, std::size_t length) {
+    // Skip the type and key to find the bytes of the value.
+    auto key_length = std::strlen(reinterpret_cast<const char*>(element + 1)) + 1;
+    auto value = element + 1 + key_length;
+    auto value_length = length - 1 - key_length;
+
+    // Rebuild the element as the only element of the document {"v": <value>}. BSON lengths are
+    // little-endian whatever the byte order of the host.
+    auto doc_length = static_cast<std::uint32_t>(4 + 1 + 2 + value_length + 1);
+    std::vector<std::uint8_t> doc(doc_length);
+    for (std::size_t i = 0; i < 4; ++i) {
+        doc[i] = static_cast<std::uint8_t>(doc_length >> (8 * i));
+    }
+    doc[4] = element[0];
+    doc[5] = 'v';
+    doc[6] = '\0';
+    std::memcpy(doc.data() + 7, value, value_length);
+    doc[doc_length - 1] = '\0';
+
+    raw_value_holder<T> holder{};
+    to_obj(bsoncxx::document::view{doc.data(), doc.size()}, holder);
+    return std::move(holder.value);
+}
+
+/**
+ * A flag that is set once and can then be cleared by exactly one of several concurrent callers.
+ * Unlike std::atomic<bool>, it can be copied, so that the classes holding it stay copyable.
+ */
+class copyable_flag {
+   public:
+    copyable_flag(bool set = false) : _set(set) {
+    }
+
+    copyable_flag(const copyable_flag& other) : _set(other._set.load()) {
+    }
+
+    copyable_flag& operator=(const copyable_flag& other) {
+        _set.store(other._set.load());
+        return *this;
+    }
+
+    /**
+     * Clears the flag, and returns true if this call is the one that cleared it.
+     */
+    bool clear() {
+        return _set.load(std::memory_order_relaxed) && _set.exchange(false);
+    }
+
+   private:
+    std::atomic<bool> _set;
+};
+
+}  // namespace details
+
+/**
+ * A random-access view of a BSON array, that decodes its elements on demand.
+ *
+ * Reaching the i-th element of a BSON array normally requires a linear scan. When a lazy_vector<T>
+ * is loaded by a BSONInputArchive, it instead walks the array once to build a table of the offsets
+ * of its elements, which makes size() and element access O(1). Only the elements that are actually
+ * accessed are decoded. Like lazy<T>, it shares ownership of the document it was loaded from, and
+ * an unmodified lazy_vector<T> is saved by copying the array's original bytes.
+ *
+ * Elements are returned by value and are decoded again on every access. To modify the array, call
+ * get(), which decodes every element into a std::vector<T> that is re-encoded when saved.
+ *
+ * Like other const access to a std::vector, the const member functions may be called concurrently
+ * from several threads, as long as no thread calls a non-const member function at the same time.
+ *
+ * @tparam T A default-constructible type that is serializable using a BSONArchiver.
+ */
+template <class T>
+class lazy_vector {
+    static_assert(std::is_default_constructible<T>::value,
+                  "Template type must be default constructible");
+
+   public:
+    using value_type = T;
+    using size_type = std::size_t;
+
+    /**
+     * Constructs an empty lazy_vector<T>.
+     */
+    lazy_vector() : _values(std::vector<T>{}) {
+    }
+
+    /**
+     * Constructs a lazy_vector<T> holding the given elements.
+     */
+    lazy_vector(std::vector<T> values) : _values(std::move(values)) {
+    }
+
+    lazy_vector& operator=(std::vector<T> values) {
+        _values = std::move(values);
+        release_raw();
+        return *this;
+    }
+
+    /**
+     * Returns the number of elements, without decoding any of them.
+     */
+    size_type size() const {
+        return _values ? _values->size() : _offsets.size() - 1;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    /**
+     * Decodes and returns the element at the given index. The index is not bounds-checked.
+     *
+     * @throws boson::Exception if the element cannot be deserialized into a T.
+     */
+    T operator[](size_type i) const {
+        if (_values) {
+            return (*_values)[i];
+        }
+        if (_unobserved.clear()) {
+            _observer->field_accessed(_name);
+        }
+        return details::decode_raw_element<T>(_array.data() + _offsets[i],
+                                              _offsets[i + 1] - _offsets[i]);
+    }
+
+    /**
+     * Decodes and returns the element at the given index.
+     *
+     * @throws std::out_of_range if the index is not less than size().
+     * @throws boson::Exception if the element cannot be deserialized into a T.
+     */
+    T at(size_type i) const {
+        if (i >= size()) {
+            throw std::out_of_range("lazy_vector index out of range");
+        }
+        return (*this)[i];
+    }
+
+    T front() const {
+        return at(0);
+    }
+
+    T back() const {
+        return at(size() - 1);
+    }
+
+    /**
+     * Decodes every element that has not been decoded yet and returns them. Since the elements
+     * may be modified through the returned reference, they will be re-encoded when saved.
+     *
+     * @throws boson::Exception if an element cannot be deserialized into a T.
+     */
+    std::vector<T>& get() {
+        if (!_values) {
+            std::vector<T> values;
+            values.reserve(size());
+            for (size_type i = 0; i < size(); ++i) {
+                values.push_back((*this)[i]);
+            }
+            _values = std::move(values);
+            release_raw();
+        }
+        return *_values;
+    }
+
+    /**
+     * Returns true if the elements have been decoded or assigned, and false if they are still held
+     * as raw BSON.
+     */
+    bool is_decoded() const {
+        return static_cast<bool>(_values);
+    }
+
+    /**
+     * Loads the current element from the archive and builds the offset table of its elements,
+     * without decoding any of them.
+     *
+     * @throws boson::Exception if the current element is not an array.
+     */
+    void load_from(BSONInputArchive& ar) {
+        auto value = ar.loadRawValue(_owner);
+        if (value.type() != bsoncxx::type::k_array) {
+            throw boson::Exception("Type mismatch when loading lazy_vector, expected an array.");
+        }
+
+        _array = value.get_array().value;
+        _offsets.clear();
+        for (const auto& element : _array) {
+            _offsets.push_back(
+                static_cast<std::uint32_t>(element.raw() + element.offset() - _array.data()));
+        }
+        // The end of the last element is the array's trailing null byte.
+        _offsets.push_back(static_cast<std::uint32_t>(_array.length() - 1));
+        _values = stdx::nullopt;
+        _observer = details::observe_field_load(ar, _name);
+        _unobserved = details::copyable_flag{static_cast<bool>(_observer)};
+    }
+
+    /**
+     * Saves the elements to the archive, copying the original bytes if they were never decoded.
+     */
+    void save_to(BSONOutputArchive& ar) const {
+        if (_values) {
+            ar(*_values);
+            return;
+        }
+
+        ar.writeName();
+        ar.saveRawValue(bsoncxx::types::value{bsoncxx::types::b_array{_array}});
+        ar.writeDocIfRoot();
+    }
+
+   private:
+    void release_raw() {
+        _array = bsoncxx::array::view{};
+        _offsets.clear();
+        _offsets.shrink_to_fit();
+        _owner.reset();
+    }
+
+    // The decoded elements, or an empty optional if they are still held as raw BSON.
+    stdx::optional<std::vector<T>> _values;
+
+    // The raw array, the offsets of its elements followed by the offset of its end, and the
+    // document data that the array points into.
+    bsoncxx::array::view _array;
+    std::vector<std::uint32_t> _offsets;
+    std::shared_ptr<uint8_t> _owner;
+
+    // The observer to notify when an element is first decoded, and the name of this field. The
+    // flag is cleared by the access that notifies it, which may race with other const accesses.
+    std::shared_ptr<field_observer> _observer;
+    mutable details::copyable_flag _unobserved;
+    std::string _name;
+};
+
+// ######################################################################
+// Prologue and epilogue for lazy_vector<T>, which is a single element like lazy<T>.
+
+template <class T>
+inline void prologue(BSONOutputArchive&, lazy_vector<T> const&) {
+}
+
+template <class T>
+inline void epilogue(BSONOutputArchive&, lazy_vector<T> const&) {
+}
+
+template <class T>
+inline void prologue(BSONInputArchive&, lazy_vector<T> const&) {
+}
+
+template <class T>
+inline void epilogue(BSONInputArchive&, lazy_vector<T> const&) {
+}
+
+// Saving lazy_vector<T> to BSON
+template <class T>
+inline void CEREAL_SAVE_FUNCTION_NAME(BSONOutputArchive& ar, lazy_vector<T> const& t) {
+    t.save_to(ar);
+}
+
+// Loading lazy_vector<T> from BSON
+template <class T>
+inline void CEREAL_LOAD_FUNCTION_NAME(BSONInputArchive& ar, lazy_vector<T>& t) {
+    t.load_from(ar);
+}
+
+BOSON_INLINE_NAMESPACE_END
+}  // namespace boson
+
+#include <boson/config/postlude.hpp>
@@ -0,0 +1,159 @@
+// Copyright 2016 MongoDB Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <bsoncxx/json.hpp>
+
+#include <boson/lazy.hpp>
+#include <boson/lazy_vector.hpp>
+#include <boson/mapping_functions.hpp>
+#include <boson/stdx/optional.hpp>
+
+using boson::lazy;
+using boson::lazy_vector;
+using boson::stdx::optional;
+
+struct AuditEntry {
+    std::string action;
+    int32_t user;
+
+    template <class Archive>
+    void serialize(Archive& ar) {
+        ar(CEREAL_NVP(action), CEREAL_NVP(user));
+    }
+};
+
+struct Order {
+    int32_t number;
+    lazy<std::vector<AuditEntry>> audit;
+    optional<lazy<AuditEntry>> last_audit;
+
+    template <class Archive>
+    void serialize(Archive& ar) {
+        ar(CEREAL_NVP(number), CEREAL_NVP(audit), CEREAL_NVP(last_audit));
+    }
+};
+
+TEST_CASE("lazy<T> defers decoding until first access", "[boson::lazy]") {
+    auto doc = bsoncxx::from_json(
+        R"({"number": 7, "audit": [{"action": "create", "user": 1},
+                                   {"action": "pay", "user": 2}],
+            "last_audit": {"action": "pay", "user": 2}})");
+
+    auto order = boson::to_obj<Order>(doc.view());
+    REQUIRE(order.number == 7);
+    REQUIRE(!order.audit.is_decoded());
+    REQUIRE(order.last_audit);
+    REQUIRE(!order.last_audit->is_decoded());
+
+    REQUIRE(order.audit->size() == 2);
+    REQUIRE(order.audit.is_decoded());
+    REQUIRE(order.audit.get()[1].action == "pay");
+    REQUIRE((*order.last_audit)->user == 2);
+}
+
+TEST_CASE("lazy<T> re-serializes unread fields from their original bytes", "[boson::lazy]") {
+    auto doc = bsoncxx::from_json(
+        R"({"number": 7, "audit": [{"action": "create", "user": 1, "extra": true}]})");
+
+    auto order = boson::to_obj<Order>(doc.view());
+    REQUIRE(!order.last_audit);
+
+    SECTION("Unread fields are copied verbatim, including fields that T does not map.") {
+        auto saved = boson::to_document(order);
+        REQUIRE(saved.view() == doc.view());
+    }
+
+    SECTION("Fields that were accessed are re-encoded from their value.") {
+        order.audit->push_back(AuditEntry{"ship", 3});
+        auto saved = boson::to_document(order);
+
+        auto audit = saved.view()["audit"].get_array().value;
+        REQUIRE(std::distance(audit.begin(), audit.end()) == 2);
+        REQUIRE(!audit[0].get_document().value["extra"]);
+        REQUIRE(audit[1]["action"].get_utf8().value.to_string() == "ship");
+    }
+
+    SECTION("Assigning a value replaces the raw BSON.") {
+        order.audit = std::vector<AuditEntry>{};
+        auto saved = boson::to_document(order);
+        REQUIRE(saved.view()["audit"].get_array().value.empty());
+    }
+}
+
+TEST_CASE("A lazy<T> outlives the document it was loaded from", "[boson::lazy]") {
+    Order order;
+    {
+        auto doc = bsoncxx::from_json(R"({"number": 1, "audit": [{"action": "x", "user": 5}]})");
+        order = boson::to_obj<Order>(doc.view());
+    }
+    REQUIRE(order.audit->at(0).user == 5);
+}
+
+struct Series {
+    lazy_vector<int32_t> points;
+    lazy_vector<AuditEntry> events;
+
+    template <class Archive>
+    void serialize(Archive& ar) {
+        ar(CEREAL_NVP(points), CEREAL_NVP(events));
+    }
+};
+
+TEST_CASE("lazy_vector<T> gives random access to array elements without decoding the array",
+          "[boson::lazy_vector]") {
+    auto doc = bsoncxx::from_json(
+        R"({"points": [10, 20, 30, 40],
+            "events": [{"action": "a", "user": 1}, {"action": "b", "user": 2}]})");
+
+    auto series = boson::to_obj<Series>(doc.view());
+    REQUIRE(!series.points.is_decoded());
+    REQUIRE(series.points.size() == 4);
+    REQUIRE(series.points[0] == 10);
+    REQUIRE(series.points.back() == 40);
+    REQUIRE(series.points.at(2) == 30);
+    REQUIRE_THROWS_AS(series.points.at(4), std::out_of_range);
+
+    REQUIRE(series.events.size() == 2);
+    REQUIRE(series.events[1].action == "b");
+    REQUIRE(!series.events.is_decoded());
+
+    SECTION("Unmodified arrays are saved from their original bytes.") {
+        auto saved = boson::to_document(series);
+        REQUIRE(saved.view() == doc.view());
+    }
+
+    SECTION("Modified arrays are re-encoded.") {
+        series.points.get().push_back(50);
+        REQUIRE(series.points.is_decoded());
+        REQUIRE(series.points.size() == 5);
+
+        auto saved = boson::to_document(series);
+        auto points = saved.view()["points"].get_array().value;
+        REQUIRE(points[4].get_int32() == 50);
+    }
+}
+
+TEST_CASE("lazy_vector<T> handles empty arrays", "[boson::lazy_vector]") {
+    auto doc = bsoncxx::from_json(R"({"points": [], "events": []})");
+
+    auto series = boson::to_obj<Series>(doc.view());
+    REQUIRE(series.points.empty());
+    REQUIRE(series.events.get().empty());
+}
@@ -0,0 +1,119 @@
+// Copyright 2016 MongoDB Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <mangrove/config/prelude.hpp>
+
+#include <string>
+#include <tuple>
+#include <type_traits>
+
+#include <bsoncxx/array/value.hpp>
+#include <bsoncxx/builder/core.hpp>
+#include <bsoncxx/document/value.hpp>
+#include <bsoncxx/document/view.hpp>
+#include <bsoncxx/document/view_or_value.hpp>
+#include <bsoncxx/types.hpp>
+
+#include <mangrove/expression_syntax.hpp>
+#include <mangrove/util.hpp>
+
+namespace mangrove {
+MANGROVE_INLINE_NAMESPACE_BEGIN
+
+namespace details {
+
+/**
+ * Appends a query on array elements to a builder, with every field name prefixed by the given
+ * identifier, i.e. "field" becomes "identifier.field", and the nameless field of a free_nvp
+ * becomes "identifier". The operands of $and, $or and $nor are rewritten the same way.
+ */
+inline void append_array_filter(bsoncxx::builder::core& builder, bsoncxx::document::view query,
+                                const std::string& identifier) {
+    for (auto&& elem : query) {
+        auto key = elem.key();
+        if (!key.empty() && key[0] == '$') {
+            builder.key_owned(std::string{key.data(), key.size()});
+            if (elem.type() != bsoncxx::type::k_array) {
+                builder.append(elem.get_value());
+                continue;
+            }
+
+            builder.open_array();
+            for (auto&& operand : elem.get_array().value) {
+                builder.open_document();
+                append_array_filter(builder, operand.get_document().value, identifier);
+                builder.close_document();
+            }
+            builder.close_array();
+            continue;
+        }
+
+        std::string name = identifier;
+        if (!key.empty()) {
+            name.append(1, '.').append(key.data(), key.size());
+        }
+        builder.key_owned(name);
+        builder.append(elem.get_value());
+    }
+}
+
+}  // namespace details
+
+/**
+ * Creates an array filter, which selects the array elements modified through a $[identifier]
+ * positional operator, e.g. MANGROVE_KEY(Student::grades).filtered("low").
+ *
+ * The filter is a query expression on the elements of the array: for arrays of documents, it
+ * uses the name-value pairs of the element type, and for scalar arrays, the nameless element of
+ * the array (see MANGROVE_ELEM). For instance, array_filter("low", MANGROVE_KEY(Grade::score) <
+ * 10) yields {"low.score": {$lt: 10}}.
+ *
+ * @param identifier  The identifier used in the positional operator.
+ * @param expr        A query expression on the array elements.
+ * @return The array filter, to be passed to mangrove::array_filters().
+ */
+template <typename Expr, typename = std::enable_if_t<details::is_query_expression_v<Expr>>>
+bsoncxx::document::value array_filter(const std::string& identifier, const Expr& expr) {
+    bsoncxx::document::view_or_value query = expr;
+    auto builder = bsoncxx::builder::core(false);
+    details::append_array_filter(builder, query.view(), identifier);
+    return builder.extract_document();
+}
+
+/**
+ * Collects array filters into the array expected by the array_filters() setter of the update,
+ * find_one_and_update and bulk write options, e.g.
+ *
+ *     mongocxx::options::update opts;
+ *     opts.array_filters(array_filters(array_filter("low", MANGROVE_KEY(Grade::score) < 10)));
+ *     Student::update_many({}, MANGROVE_KEY(Student::grades).filtered("low") = ..., opts);
+ *
+ * Update expressions on the fields of the matched elements are written with ->*, e.g.
+ * MANGROVE_KEY(Student::grades).filtered("low")->*MANGROVE_KEY(Grade::score) = 10.
+ */
+template <typename... Filters>
+bsoncxx::array::value array_filters(const Filters&... filters) {
+    auto builder = bsoncxx::builder::core(true);
+    tuple_for_each(std::forward_as_tuple(filters...), [&](const bsoncxx::document::value& f) {
+        builder.append(bsoncxx::types::b_document{f.view()});
+    });
+    return builder.extract_array();
+}
+
+MANGROVE_INLINE_NAMESPACE_END
+}  // namespace mangrove
+
+#include <mangrove/config/postlude.hpp>
@@ -0,0 +1,176 @@
+// Copyright 2016 MongoDB Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <mangrove/config/prelude.hpp>
+
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <bsoncxx/builder/core.hpp>
+#include <bsoncxx/document/value.hpp>
+#include <bsoncxx/document/view.hpp>
+#include <bsoncxx/document/view_or_value.hpp>
+#include <bsoncxx/stdx/optional.hpp>
+
+#include <mangrove/expression_syntax.hpp>
+#include <mangrove/nvp.hpp>
+#include <mangrove/projection.hpp>
+#include <mangrove/query_builder.hpp>
+#include <mangrove/util.hpp>
+
+namespace mangrove {
+MANGROVE_INLINE_NAMESPACE_BEGIN
+
+namespace details {
+
+template <typename NvpT>
+using enable_if_array_nvp_t =
+    std::enable_if_t<is_nvp_v<NvpT> && is_iterable_v<typename NvpT::no_opt_type>>;
+
+// Builds {field: {$slice: <value>}}, where the value is appended by the given function.
+template <typename NvpT, typename F>
+bsoncxx::document::value make_slice_projection(const NvpT& field, const F& append_value) {
+    std::string name;
+    auto builder = bsoncxx::builder::core(false);
+    builder.key_owned(field.append_name(name));
+    builder.open_document();
+    builder.key_view("$slice");
+    append_value(builder);
+    builder.close_document();
+    return builder.extract_document();
+}
+
+}  // namespace details
+
+/**
+ * Creates a projection that returns only some elements of an array field, with $slice.
+ *
+ * Used on its own, the projection returns every other field in full, so the result still
+ * decodes into the model class, with a partial array. Use projection_with() to combine it with
+ * the fields of a lighter view type.
+ *
+ * @param field  A name-value pair of an array field.
+ * @param n      The number of elements to return: the first n if positive, and the last -n if
+ *               negative.
+ */
+template <typename NvpT, typename = details::enable_if_array_nvp_t<NvpT>>
+bsoncxx::document::value slice_projection(const NvpT& field, std::int32_t n) {
+    return details::make_slice_projection(
+        field, [&](bsoncxx::builder::core& builder) { builder.append(n); });
+}
+
+/**
+ * Creates a projection that returns limit elements of an array field, after skipping the first
+ * skip elements, or the last -skip elements if skip is negative.
+ */
+template <typename NvpT, typename = details::enable_if_array_nvp_t<NvpT>>
+bsoncxx::document::value slice_projection(const NvpT& field, std::int32_t skip,
+                                          std::int32_t limit) {
+    return details::make_slice_projection(field, [&](bsoncxx::builder::core& builder) {
+        builder.open_array();
+        builder.append(skip);
+        builder.append(limit);
+        builder.close_array();
+    });
+}
+
+/**
+ * Creates a projection that returns only the first element of an array field that matches a
+ * query, with $elemMatch. The query is written as for nvp::elem_match(), i.e. on the fields of
+ * the elements, or on MANGROVE_ELEM for scalar arrays. Documents without a matching element are
+ * returned without the field.
+ *
+ * Unlike $slice, a bare $elemMatch projection is inclusive: it returns only _id and the array
+ * field, so the result doesn't decode into a model class with other required members. Use
+ * projection_with() to add the fields of a view type.
+ *
+ * @param field  A name-value pair of an array field.
+ * @param query  A query expression on the elements of the array.
+ */
+template <typename NvpT, typename Expr, typename = details::enable_if_array_nvp_t<NvpT>,
+          typename = std::enable_if_t<details::is_query_expression_v<Expr>>>
+bsoncxx::document::value elem_match_projection(const NvpT& field, const Expr& query) {
+    bsoncxx::document::view_or_value projection = field.elem_match(query);
+    return bsoncxx::document::value{projection.view()};
+}
+
+namespace details {
+
+// Merges array projections into the given projection, see projection_with().
+inline bsoncxx::document::value merge_array_projections(
+    const bsoncxx::stdx::optional<bsoncxx::document::value>& base,
+    const std::vector<bsoncxx::document::view>& array_projections) {
+    auto builder = bsoncxx::builder::core(false);
+    std::vector<bool> used(array_projections.size(), false);
+
+    if (base) {
+        for (auto&& elem : base->view()) {
+            std::string name{elem.key().data(), elem.key().size()};
+            builder.key_owned(name);
+
+            // This also keeps the exclusion of _id that projection_for() adds for types that
+            // don't map it.
+            auto value = elem.get_value();
+            for (std::size_t i = 0; i < array_projections.size(); ++i) {
+                auto spec = *array_projections[i].begin();
+                if (spec.key() == elem.key()) {
+                    value = spec.get_value();
+                    used[i] = true;
+                    break;
+                }
+            }
+            builder.append(value);
+        }
+    }
+
+    for (std::size_t i = 0; i < array_projections.size(); ++i) {
+        if (!used[i]) {
+            builder.concatenate(array_projections[i]);
+        }
+    }
+    return builder.extract_document();
+}
+
+}  // namespace details
+
+/**
+ * Returns the projection that selects the fields mapped by a view type, as projection_for() does,
+ * except that the given array projections replace the plain inclusion of their fields. Array
+ * projections on fields that Result doesn't map are added as well.
+ *
+ * Example, which reads only the name and the last three grades of each student:
+ *
+ *     options::find opts;
+ *     opts.projection(projection_with<StudentSummary>(
+ *         slice_projection(MANGROVE_KEY(Student::grades), -3)));
+ *     for (StudentSummary s : Student::find<StudentSummary>({}, opts)) { ... }
+ *
+ * @tparam Result The type that documents are deserialized into. If it doesn't register its fields
+ *                with MANGROVE_MAKE_KEYS, the result only contains the array projections.
+ * @param array_projections Projections created by slice_projection() or elem_match_projection().
+ */
+template <typename Result, typename... Projections>
+bsoncxx::document::value projection_with(const Projections&... array_projections) {
+    return details::merge_array_projections(projection_for<Result>(),
+                                            {array_projections.view()...});
+}
+
+MANGROVE_INLINE_NAMESPACE_END
+}  // namespace mangrove
+
+#include <mangrove/config/postlude.hpp>
@@ -17,13 +17,21 @@
 #include <mangrove/config/prelude.hpp>
 
 #include <iostream>
+#include <memory>
+#include <vector>
 
 #include <bsoncxx/builder/basic/document.hpp>
+#include <bsoncxx/builder/basic/kvp.hpp>
 #include <bsoncxx/stdx/optional.hpp>
 #include <mongocxx/collection.hpp>
 
 #include <boson/mapping_functions.hpp>
 #include <mangrove/deserializing_cursor.hpp>
+#include <mangrove/nvp.hpp>
+#include <mangrove/projection.hpp>
+#include <mangrove/query_cache.hpp>
+#include <mangrove/query_recorder.hpp>
+#include <mangrove/value_cursor.hpp>
 
 namespace mangrove {
 MANGROVE_INLINE_NAMESPACE_BEGIN
@@ -51,6 +59,63 @@ class collection_wrapper {
         return _coll;
     }
 
+    ///
+    /// Attaches a cache for the results of find_cached(). Writes made through this object
+    /// invalidate the cached results. The same cache may be shared by several collection_wrapper
+    /// objects for the same collection, e.g. one per thread.
+    ///
+    /// @param cache
+    ///   The cache to use, or nullptr to stop caching.
+    ///
+    void cache_queries(std::shared_ptr<query_cache<T>> cache) {
+        _query_cache = std::move(cache);
+    }
+
+    ///
+    /// Attaches a recorder for the shapes of the queries made by find(), find_one(),
+    /// find_one_and_delete(), find_one_and_replace() and find_one_and_update(). The same recorder
+    /// may be shared by several collection_wrapper objects, e.g. one per thread.
+    ///
+    /// @param recorder
+    ///   The recorder to use, or nullptr to stop recording.
+    ///
+    /// @see mangrove::query_recorder
+    ///
+    void record_queries(std::shared_ptr<query_recorder> recorder) {
+        _query_recorder = std::move(recorder);
+    }
+
+    ///
+    /// Enables or disables automatic projection, which is enabled by default. When enabled,
+    /// reads that deserialize into a type registered with MANGROVE_MAKE_KEYS only fetch the
+    /// fields that the type maps (see mangrove::projection_for()), and aggregate() appends a
+    /// $project stage to pipelines that don't write their output. Reads whose options already
+    /// specify a projection are never changed, and types that inherit
+    /// boson::UnderlyingBSONDataBase are always read in full.
+    ///
+    /// @param enabled
+    ///   Whether to apply the projection automatically.
+    ///
+    void set_auto_projection(bool enabled) {
+        _auto_projection = enabled;
+    }
+
+    ///
+    /// Returns the given find options with the automatic projection for Result applied, if it is
+    /// enabled and the options don't already specify a projection.
+    ///
+    /// @tparam Result - The type that the results are deserialized into.
+    ///
+    template <class Result = T>
+    mongocxx::options::find projected(const mongocxx::options::find& options) const {
+        mongocxx::options::find result{options};
+        const auto& projection = projection_for<Result>();
+        if (_auto_projection && projection && !options.projection()) {
+            result.projection(projection->view());
+        }
+        return result;
+    }
+
     ///
     /// Runs an aggregation framework pipeline against this collection, and returns the results
     /// as de-serialized objects.
@@ -70,16 +135,32 @@ class collection_wrapper {
     ///
     /// @see http://docs.mongodb.org/manual/reference/command/aggregate/
     ///
+    /// If automatic projection is enabled (see set_auto_projection()) and Result is registered
+    /// with MANGROVE_MAKE_KEYS, a $project stage selecting the fields that Result maps is appended
+    /// to the pipeline, unless it ends with $out or $merge.
+    ///
     template <class Result = T>
     deserializing_cursor<Result> aggregate(
         const mongocxx::pipeline& pipeline,
         const mongocxx::options::aggregate& options = mongocxx::options::aggregate()) {
-        return deserializing_cursor<Result>(_coll.aggregate(pipeline, options));
+        const auto& projection = projection_for<Result>();
+        if (!_auto_projection || !projection || writes_output(pipeline)) {
+            return deserializing_cursor<Result>(_coll.aggregate(pipeline, options));
+        }
+
+        mongocxx::pipeline projected_pipeline;
+        projected_pipeline.append_stages(pipeline.view_array());
+        projected_pipeline.project(projection->view());
+        return deserializing_cursor<Result>(_coll.aggregate(projected_pipeline, options));
     }
 
     ///
     /// Finds the documents in this collection which match the provided filter.
+    /// This function is templated on the result's type, which may be a lighter view type mapping
+    /// only some of the fields of the documents in the collection. With automatic projection (see
+    /// set_auto_projection()), only the fields that the result type maps are fetched.
     ///
+    /// @tparam Result - The type that the documents are deserialized into.
     /// @param filter
     ///   Document view representing a document that should match the query.
     /// @param options
@@ -92,15 +173,108 @@ class collection_wrapper {
     ///
     /// @see http://docs.mongodb.org/manual/core/read-operations-introduction/
     ///
-    deserializing_cursor<T> find(
+    template <class Result = T>
+    deserializing_cursor<Result> find(
+        bsoncxx::document::view_or_value filter,
+        const mongocxx::options::find& options = mongocxx::options::find()) {
+        if (_query_recorder) {
+            _query_recorder->record("find", filter.view(), details::sort_of(options));
+        }
+        return deserializing_cursor<Result>(_coll.find(filter, projected<Result>(options)));
+    }
+
+    ///
+    /// Finds the documents in this collection which match the provided filter, and returns all of
+    /// them as deserialized objects. If a cache is attached (see cache_queries()), identical
+    /// queries are answered from the cache until the next write made through this object.
+    ///
+    /// @param filter
+    ///   Document view representing a document that should match the query.
+    /// @param options
+    ///   Optional arguments, see mongocxx::options::find
+    ///
+    /// @return A shared, immutable vector of the deserialized objects.
+    /// @throws mongocxx::exception::query if the operation fails.
+    ///
+    std::shared_ptr<const std::vector<T>> find_cached(
         bsoncxx::document::view_or_value filter,
         const mongocxx::options::find& options = mongocxx::options::find()) {
-        return deserializing_cursor<T>(_coll.find(filter, options));
+        return details::cached_find<T>(_coll, _query_cache.get(), filter.view(),
+                                       projected(options));
+    }
+
+    ///
+    /// Finds the documents in this collection which match the provided filter, and yields the
+    /// value of a single field from each of them. Only that field is fetched from the server, and
+    /// the rest of the document is never deserialized.
+    ///
+    /// @param field
+    ///   A name-value pair representing the field, e.g. MANGROVE_KEY(Restaurant::name).
+    /// @param filter
+    ///   Document view representing a document that should match the query.
+    /// @param options
+    ///   Optional arguments, see mongocxx::options::find. If no projection is specified, one that
+    ///   selects only the field is used.
+    ///
+    /// @return Cursor yielding the values of the field.
+    /// @throws
+    ///   If the find failed, the returned cursor will throw mongocxx::exception::query when it
+    ///   is iterated.
+    ///
+    template <typename NvpT, typename = std::enable_if_t<is_nvp_v<NvpT>>>
+    value_cursor<typename NvpT::type> find_values(
+        const NvpT& field,
+        bsoncxx::document::view_or_value filter = bsoncxx::document::view_or_value{},
+        const mongocxx::options::find& options = mongocxx::options::find()) {
+        std::string path;
+        field.append_name(path);
+
+        mongocxx::options::find value_options{options};
+        if (!options.projection()) {
+            value_options.projection(details::value_projection(path));
+        }
+
+        return value_cursor<typename NvpT::type>(_coll.find(filter, value_options),
+                                                 std::move(path));
+    }
+
+    ///
+    /// Finds the distinct values of a field across the documents matching the provided filter.
+    /// If the field is an array, the distinct values of its elements are returned.
+    ///
+    /// @param field
+    ///   A name-value pair representing the field, e.g. MANGROVE_KEY(Restaurant::cuisine).
+    /// @param filter
+    ///   Document view representing the documents to consider.
+    /// @param options
+    ///   Optional arguments, see mongocxx::options::distinct.
+    ///
+    /// @return A vector of the distinct values.
+    /// @throws mongocxx::exception::query if the operation fails.
+    /// @throws boson::Exception if the values cannot be deserialized into the field's type.
+    ///
+    /// @see https://docs.mongodb.com/manual/reference/command/distinct/
+    ///
+    template <typename NvpT, typename = std::enable_if_t<is_nvp_v<NvpT>>>
+    std::vector<typename NvpT::array_element_type> distinct(
+        const NvpT& field,
+        bsoncxx::document::view_or_value filter = bsoncxx::document::view_or_value{},
+        const mongocxx::options::distinct& options = mongocxx::options::distinct()) {
+        std::string path;
+        field.append_name(path);
+
+        details::value_holder<std::vector<typename NvpT::array_element_type>> holder{"values", {}};
+        for (auto&& doc : _coll.distinct(path, filter, options)) {
+            boson::to_obj(doc, holder);
+        }
+        return std::move(holder.value);
     }
 
     ///
     /// Finds a single document in this collection that match the provided filter.
+    /// As with find(), the result type may differ from the type of the collection's documents.
     ///
+    /// @tparam Result - The type that the document is deserialized into.
     /// @param filter
     ///   Document view representing a document that should match the query.
     /// @param options
@@ -111,10 +285,15 @@ class collection_wrapper {
     ///
     /// @see http://docs.mongodb.org/manual/core/read-operations-introduction/
     ///
-    mongocxx::stdx::optional<T> find_one(
+    template <class Result = T>
+    mongocxx::stdx::optional<Result> find_one(
         bsoncxx::document::view_or_value filter,
         const mongocxx::options::find& options = mongocxx::options::find()) {
-        return boson::to_optional_obj<T>(_coll.find_one(filter, options));
+        return details::record_query(
+            _query_recorder.get(), "find_one", filter.view(), details::sort_of(options), [&] {
+                return boson::to_optional_obj<Result>(
+                    _coll.find_one(filter.view(), projected<Result>(options)));
+            });
     }
 
     ///
@@ -133,7 +312,13 @@ class collection_wrapper {
         bsoncxx::document::view_or_value filter,
         const mongocxx::options::find_one_and_delete& options =
             mongocxx::options::find_one_and_delete()) {
-        return boson::to_optional_obj<T>(_coll.find_one_and_delete(filter, options));
+        auto result = details::record_query(
+            _query_recorder.get(), "find_one_and_delete", filter.view(), details::sort_of(options),
+            [&] {
+                return boson::to_optional_obj<T>(_coll.find_one_and_delete(filter.view(), options));
+            });
+        written();
+        return result;
     }
 
     ///
@@ -159,8 +344,45 @@ class collection_wrapper {
         bsoncxx::document::view_or_value filter, const T& replacement,
         const mongocxx::options::find_one_and_replace& options =
             mongocxx::options::find_one_and_replace()) {
-        return boson::to_optional_obj<T>(
-            _coll.find_one_and_replace(filter, boson::to_document(replacement), options));
+        auto result = details::record_query(
+            _query_recorder.get(), "find_one_and_replace", filter.view(),
+            details::sort_of(options), [&] {
+                return boson::to_optional_obj<T>(_coll.find_one_and_replace(
+                    filter.view(), boson::to_document(replacement), options));
+            });
+        written();
+        return result;
+    }
+
+    ///
+    /// Finds a single document matching the filter, applies an update to it, and returns either
+    /// the original or the updated document as a deserialized object, in one round-trip.
+    ///
+    /// @param filter
+    ///   Document view representing a document that should be updated. This may be a query
+    ///   builder expression.
+    /// @param update
+    ///   Document representing the update to apply to the matching document. This may be a
+    ///   query builder update expression, e.g. MANGROVE_KEY(Job::attempts) += 1.
+    /// @param options
+    ///   Optional arguments, see mongocxx::options::find_one_and_update. Use return_document()
+    ///   to get the updated document instead of the original.
+    ///
+    /// @return The original or updated object, or an empty optional if no document matched.
+    /// @throws mongocxx::exception::write if the operation fails.
+    ///
+    mongocxx::stdx::optional<T> find_one_and_update(
+        bsoncxx::document::view_or_value filter, bsoncxx::document::view_or_value update,
+        const mongocxx::options::find_one_and_update& options =
+            mongocxx::options::find_one_and_update()) {
+        auto result = details::record_query(
+            _query_recorder.get(), "find_one_and_update", filter.view(), details::sort_of(options),
+            [&] {
+                return boson::to_optional_obj<T>(
+                    _coll.find_one_and_update(filter.view(), update, options));
+            });
+        written();
+        return result;
     }
 
     ///
@@ -179,7 +401,9 @@ class collection_wrapper {
     ///
     mongocxx::stdx::optional<mongocxx::result::insert_one> insert_one(
         T obj, const mongocxx::options::insert& options = mongocxx::options::insert()) {
-        return _coll.insert_one(boson::to_document(obj), options);
+        auto result = _coll.insert_one(boson::to_document(obj), options);
+        written();
+        return result;
     }
 
     ///
@@ -242,8 +466,11 @@ class collection_wrapper {
     mongocxx::stdx::optional<mongocxx::result::insert_many> insert_many(
         object_iterator_type begin, object_iterator_type end,
         const mongocxx::options::insert& options = mongocxx::options::insert()) {
-        return _coll.insert_many(boson::serializing_iterator<object_iterator_type>(begin),
-                                 boson::serializing_iterator<object_iterator_type>(end), options);
+        auto result =
+            _coll.insert_many(boson::serializing_iterator<object_iterator_type>(begin),
+                              boson::serializing_iterator<object_iterator_type>(end), options);
+        written();
+        return result;
     }
 
     ///
@@ -264,11 +491,40 @@ class collection_wrapper {
     mongocxx::stdx::optional<mongocxx::result::replace_one> replace_one(
         bsoncxx::document::view_or_value filter, const T& replacement,
         const mongocxx::options::update& options = mongocxx::options::update()) {
-        return _coll.replace_one(filter, boson::to_document(replacement), options);
+        auto result = _coll.replace_one(filter, boson::to_document(replacement), options);
+        written();
+        return result;
     }
 
    private:
+    // Checks whether the last stage of a pipeline writes its output to a collection, in which
+    // case no further stages may be appended to it.
+    static bool writes_output(const mongocxx::pipeline& pipeline) {
+        bsoncxx::stdx::optional<bsoncxx::document::view> last;
+        for (auto&& stage : pipeline.view_array()) {
+            last = stage.get_document().value;
+        }
+
+        if (!last || last->begin() == last->end()) {
+            return false;
+        }
+
+        auto name = last->begin()->key();
+        return name == bsoncxx::stdx::string_view{"$out"} ||
+               name == bsoncxx::stdx::string_view{"$merge"};
+    }
+
+    // Invalidates the cached query results after a write.
+    void written() {
+        if (_query_cache) {
+            _query_cache->bump_epoch();
+        }
+    }
+
     mongocxx::collection _coll;
+    std::shared_ptr<query_cache<T>> _query_cache;
+    std::shared_ptr<query_recorder> _query_recorder;
+    bool _auto_projection = true;
 };
 
 MANGROVE_INLINE_NAMESPACE_END
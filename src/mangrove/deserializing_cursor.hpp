@@ -17,12 +17,14 @@
 #include <mangrove/config/prelude.hpp>
 
 #include <iostream>
+#include <memory>
 
 #include <bsoncxx/builder/basic/document.hpp>
 #include <bsoncxx/stdx/optional.hpp>
 #include <mongocxx/cursor.hpp>
 
 #include <boson/mapping_functions.hpp>
+#include <mangrove/field_access.hpp>
 
 namespace mangrove {
 MANGROVE_INLINE_NAMESPACE_BEGIN
@@ -36,32 +38,43 @@ MANGROVE_INLINE_NAMESPACE_BEGIN
 template <class T>
 class deserializing_cursor {
    public:
-    deserializing_cursor(mongocxx::cursor&& c) : _c(std::move(c)) {
+    /**
+     * @param c The cursor of documents to deserialize.
+     * @param tracked
+     *   If not null, the field accesses of the deserialized objects are recorded under this query
+     *   shape, see mangrove::field_access_tracker.
+     */
+    deserializing_cursor(mongocxx::cursor&& c,
+                         std::shared_ptr<field_access_tracker::shape> tracked = nullptr)
+        : _c(std::move(c)), _tracked(std::move(tracked)) {
     }
 
     class iterator;
 
     iterator begin() {
-        return iterator(_c.begin(), _c.end());
+        return iterator(_c.begin(), _c.end(), _tracked);
     }
 
     iterator end() {
-        return iterator(_c.end(), _c.end());
+        return iterator(_c.end(), _c.end(), _tracked);
     }
 
    private:
     mongocxx::cursor _c;
+    std::shared_ptr<field_access_tracker::shape> _tracked;
 };
 
 template <class T>
 class deserializing_cursor<T>::iterator : public std::iterator<std::input_iterator_tag, T> {
    public:
-    iterator(mongocxx::cursor::iterator ci, mongocxx::cursor::iterator ci_end)
-        : _ci(ci), _ci_end(ci_end) {
+    iterator(mongocxx::cursor::iterator ci, mongocxx::cursor::iterator ci_end,
+             std::shared_ptr<field_access_tracker::shape> tracked = nullptr)
+        : _ci(ci), _ci_end(ci_end), _tracked(std::move(tracked)) {
         skip_invalid_documents();
     }
 
-    iterator(const deserializing_cursor::iterator& dsi) : _ci(dsi._ci), _ci_end(dsi._ci_end) {
+    iterator(const deserializing_cursor::iterator& dsi)
+        : _ci(dsi._ci), _ci_end(dsi._ci_end), _tracked(dsi._tracked) {
         skip_invalid_documents();
     }
 
@@ -96,6 +109,8 @@ class deserializing_cursor<T>::iterator : public std::iterator<std::input_iterat
     mongocxx::cursor::iterator _ci;
     // Keeps track of the end of the underlying cursor to enable skipping invalid documents.
     mongocxx::cursor::iterator _ci_end;
+    // The query shape under which field accesses are recorded, or null if they aren't.
+    std::shared_ptr<field_access_tracker::shape> _tracked;
     // Cached object value. When this is non-empty, this always contains the current object pointed
     // to by the cursor.
     mongocxx::stdx::optional<T> _opt;
@@ -112,7 +127,7 @@ class deserializing_cursor<T>::iterator : public std::iterator<std::input_iterat
         while (_ci != _ci_end) {
             try {
                 if (!_opt) {
-                    _opt = boson::to_obj<T>(*_ci);
+                    _opt = _tracked ? _tracked->template decode<T>(*_ci) : boson::to_obj<T>(*_ci);
                 }
                 return;
             } catch (boson::Exception& e) {
@@ -56,6 +56,12 @@ class comparison_expr;
 template <typename NvpT, typename U>
 class comparison_value_expr;
 
+template <typename NvpT, typename U>
+class range_expr;
+
+template <typename NvpT>
+class geo_expr;
+
 template <typename Expr>
 class not_expr;
 
@@ -121,6 +127,12 @@ struct expression_type<comparison_expr<NvpT, U>> : public expression_query_t {};
 template <typename NvpT, typename U>
 struct expression_type<comparison_value_expr<NvpT, U>> : public expression_query_t {};
 
+template <typename NvpT, typename U>
+struct expression_type<range_expr<NvpT, U>> : public expression_query_t {};
+
+template <typename NvpT>
+struct expression_type<geo_expr<NvpT>> : public expression_query_t {};
+
 template <typename Expr>
 struct expression_type<not_expr<Expr>> : public expression_query_t {};
 
@@ -0,0 +1,305 @@
+// Copyright 2016 MongoDB Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <mangrove/config/prelude.hpp>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <bsoncxx/builder/core.hpp>
+#include <bsoncxx/document/value.hpp>
+#include <bsoncxx/document/view.hpp>
+#include <bsoncxx/stdx/optional.hpp>
+
+#include <boson/lazy.hpp>
+#include <boson/mapping_functions.hpp>
+#include <mangrove/projection.hpp>
+#include <mangrove/util.hpp>
+
+namespace mangrove {
+MANGROVE_INLINE_NAMESPACE_BEGIN
+
+/**
+ * How often a single top-level field was fetched and read by the queries of one shape.
+ */
+struct field_usage {
+    std::string name;
+
+    /**
+     * The number of fetched documents that contained the field.
+     */
+    std::uint64_t fetched = 0;
+
+    /**
+     * The number of fetched documents in which the field was read. For boson::lazy and
+     * boson::lazy_vector members, this counts the documents in which the value was accessed.
+     * Other fields are decoded eagerly, and count as read whenever the result type maps them.
+     */
+    std::uint64_t read = 0;
+
+    /**
+     * Whether the field was held in a boson::lazy or boson::lazy_vector member, so that read
+     * counts actual accesses by the application rather than decoding.
+     */
+    bool deferred = false;
+};
+
+/**
+ * The field usage of the queries of one shape, see mangrove::query_shape().
+ */
+struct field_access_report {
+    std::string shape;
+
+    /**
+     * The number of documents fetched by queries of this shape.
+     */
+    std::uint64_t documents = 0;
+
+    /**
+     * The usage of every field that was fetched at least once, ordered by name.
+     */
+    std::vector<field_usage> fields;
+
+    /**
+     * A projection selecting only the fields that were read at least once, or an empty optional
+     * if every fetched field was read.
+     */
+    bsoncxx::stdx::optional<bsoncxx::document::value> suggested_projection;
+};
+
+/**
+ * Records which of the fields fetched by queries are used, aggregated per query shape.
+ *
+ * Accesses can only be observed for fields held in boson::lazy or boson::lazy_vector members,
+ * which count as read once their value is accessed. Fields that are deserialized eagerly count as
+ * read if the result type maps them, or if it doesn't register its fields with MANGROVE_MAKE_KEYS
+ * at all, since there is no way to observe reads of plain members. To find out which heavy fields
+ * of a model the application actually reads, declare them as lazy members while tracking.
+ * Only top-level fields are tracked.
+ */
+class field_access_tracker {
+   public:
+    /**
+     * The statistics of the queries of one shape.
+     */
+    class shape : public std::enable_shared_from_this<shape> {
+       public:
+        explicit shape(std::string name) : _name(std::move(name)) {
+        }
+
+        shape(const shape&) = delete;
+        shape& operator=(const shape&) = delete;
+
+        /**
+         * Deserializes a document fetched by a query of this shape, and records its fields.
+         *
+         * @throws boson::Exception if the document cannot be deserialized into a T.
+         */
+        template <typename T>
+        T decode(bsoncxx::document::view doc);
+
+       private:
+        friend class field_access_tracker;
+        class observer;
+
+        void record_read(const std::string& field) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto it = _fields.find(field);
+            if (it != _fields.end()) {
+                ++it->second.read;
+            }
+        }
+
+        field_access_report report() const;
+
+        const std::string _name;
+        mutable std::mutex _mutex;
+        std::uint64_t _documents = 0;
+        std::map<std::string, field_usage> _fields;
+    };
+
+    field_access_tracker() = default;
+
+    field_access_tracker(const field_access_tracker&) = delete;
+    field_access_tracker& operator=(const field_access_tracker&) = delete;
+
+    /**
+     * Returns the statistics of the queries with the given shape, creating them if necessary.
+     */
+    std::shared_ptr<shape> shape_for(const std::string& name) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto& s = _shapes[name];
+        if (!s) {
+            s = std::make_shared<shape>(name);
+        }
+        return s;
+    }
+
+    /**
+     * Returns the field usage of every query shape recorded so far.
+     */
+    std::vector<field_access_report> report() const {
+        std::vector<std::shared_ptr<shape>> shapes;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (const auto& kv : _shapes) {
+                shapes.push_back(kv.second);
+            }
+        }
+
+        std::vector<field_access_report> result;
+        for (const auto& s : shapes) {
+            result.push_back(s->report());
+        }
+        return result;
+    }
+
+   private:
+    mutable std::mutex _mutex;
+    std::unordered_map<std::string, std::shared_ptr<shape>> _shapes;
+};
+
+namespace details {
+
+template <typename T>
+std::enable_if_t<has_mapped_fields_v<T>, bool> maps_field(const std::string& name) {
+    static const std::set<std::string> mapped = [] {
+        std::set<std::string> names;
+        tuple_for_each(T::mangrove_mapped_fields(),
+                       [&](const auto& nvp) { names.emplace(nvp.name); });
+        return names;
+    }();
+    return mapped.count(name) > 0;
+}
+
+template <typename T>
+std::enable_if_t<!has_mapped_fields_v<T>, bool> maps_field(const std::string&) {
+    return true;
+}
+
+}  // namespace details
+
+// Collects the lazy fields of one document, and records their first access.
+class field_access_tracker::shape::observer : public boson::field_observer {
+   public:
+    explicit observer(std::shared_ptr<shape> s) : _shape(std::move(s)) {
+    }
+
+    void field_loaded(const std::string& name) override {
+        _lazy_fields.insert(name);
+    }
+
+    void field_accessed(const std::string& name) override {
+        _shape->record_read(name);
+    }
+
+    bool is_lazy(const std::string& name) const {
+        return _lazy_fields.count(name) > 0;
+    }
+
+   private:
+    std::shared_ptr<shape> _shape;
+    std::set<std::string> _lazy_fields;
+};
+
+template <typename T>
+T field_access_tracker::shape::decode(bsoncxx::document::view doc) {
+    // The lazy fields of the object keep the observer, and through it this shape, alive until
+    // they are accessed.
+    auto obs = std::make_shared<observer>(shared_from_this());
+
+    auto& current = boson::current_field_observer();
+    auto previous = std::move(current);
+    current = obs;
+
+    T obj;
+    try {
+        boson::to_obj(doc, obj);
+    } catch (...) {
+        current = std::move(previous);
+        throw;
+    }
+    current = std::move(previous);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    ++_documents;
+    for (const auto& element : doc) {
+        std::string name(element.key().data(), element.key().size());
+        auto& usage = _fields[name];
+        ++usage.fetched;
+        if (obs->is_lazy(name)) {
+            usage.deferred = true;
+        } else if (details::maps_field<T>(name)) {
+            ++usage.read;
+        }
+    }
+
+    return obj;
+}
+
+inline field_access_report field_access_tracker::shape::report() const {
+    field_access_report result;
+    result.shape = _name;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    result.documents = _documents;
+
+    auto builder = bsoncxx::builder::core(false);
+    bool over_fetched = false;
+    bool reads_id = true;
+
+    for (const auto& kv : _fields) {
+        auto usage = kv.second;
+        usage.name = kv.first;
+        result.fields.push_back(usage);
+
+        if (usage.read > 0) {
+            if (usage.name != "_id") {
+                builder.key_owned(usage.name);
+                builder.append(std::int32_t{1});
+            }
+        } else if (usage.fetched > 0) {
+            over_fetched = true;
+            if (usage.name == "_id") {
+                reads_id = false;
+            }
+        }
+    }
+
+    if (over_fetched) {
+        // _id is returned unless explicitly excluded.
+        if (!reads_id) {
+            builder.key_view("_id");
+            builder.append(std::int32_t{0});
+        }
+        result.suggested_projection = builder.extract_document();
+    }
+
+    return result;
+}
+
+MANGROVE_INLINE_NAMESPACE_END
+}  // namespace mangrove
+
+#include <mangrove/config/postlude.hpp>
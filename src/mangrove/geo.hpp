@@ -0,0 +1,295 @@
+// Copyright 2016 MongoDB Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <mangrove/config/prelude.hpp>
+
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <bsoncxx/builder/core.hpp>
+#include <bsoncxx/document/value.hpp>
+#include <bsoncxx/document/view_or_value.hpp>
+#include <bsoncxx/stdx/optional.hpp>
+#include <bsoncxx/types.hpp>
+#include <cereal/cereal.hpp>
+
+#include <boson/mapping_functions.hpp>
+#include <mangrove/expression_syntax.hpp>
+#include <mangrove/nvp.hpp>
+#include <mangrove/query_builder.hpp>
+
+namespace mangrove {
+MANGROVE_INLINE_NAMESPACE_BEGIN
+
+/**
+ * A GeoJSON point, stored as {type: "Point", coordinates: [longitude, latitude]}.
+ *
+ * Fields of this type can be indexed with a 2dsphere index (see geo_index_keys()), and queried
+ * with the geospatial operators of name-value pairs, e.g. near() and geo_within().
+ */
+class geo_point {
+   public:
+    geo_point() : geo_point(0.0, 0.0) {
+    }
+
+    /**
+     * Creates a point. Note that GeoJSON lists the longitude first.
+     */
+    geo_point(double longitude, double latitude) : _coordinates{longitude, latitude} {
+    }
+
+    double longitude() const {
+        return _coordinates.at(0);
+    }
+
+    double latitude() const {
+        return _coordinates.at(1);
+    }
+
+    /**
+     * Returns the [longitude, latitude] pair of the point.
+     */
+    const std::vector<double>& coordinates() const {
+        return _coordinates;
+    }
+
+    friend bool operator==(const geo_point& lhs, const geo_point& rhs) {
+        return lhs._coordinates == rhs._coordinates;
+    }
+
+    friend bool operator!=(const geo_point& lhs, const geo_point& rhs) {
+        return !(lhs == rhs);
+    }
+
+    template <class Archive>
+    void serialize(Archive& ar) {
+        ar(cereal::make_nvp("type", _type), cereal::make_nvp("coordinates", _coordinates));
+    }
+
+   private:
+    std::string _type = "Point";
+    std::vector<double> _coordinates;
+};
+
+/**
+ * A GeoJSON polygon, stored as {type: "Polygon", coordinates: [<exterior ring>, <holes>...]}.
+ * Every ring is a closed list of [longitude, latitude] positions.
+ */
+class geo_polygon {
+   public:
+    geo_polygon() = default;
+
+    /**
+     * Creates a polygon from its exterior ring, and optionally the rings of its holes. Rings
+     * are closed automatically, i.e. the first point doesn't need to be repeated at the end.
+     *
+     * @throws std::logic_error if a ring has fewer than three distinct points.
+     */
+    geo_polygon(const std::vector<geo_point>& exterior,
+                const std::vector<std::vector<geo_point>>& holes = {}) {
+        append_ring(exterior);
+        for (const auto& hole : holes) {
+            append_ring(hole);
+        }
+    }
+
+    /**
+     * Returns the rings of the polygon, as lists of [longitude, latitude] positions.
+     */
+    const std::vector<std::vector<std::vector<double>>>& coordinates() const {
+        return _coordinates;
+    }
+
+    friend bool operator==(const geo_polygon& lhs, const geo_polygon& rhs) {
+        return lhs._coordinates == rhs._coordinates;
+    }
+
+    friend bool operator!=(const geo_polygon& lhs, const geo_polygon& rhs) {
+        return !(lhs == rhs);
+    }
+
+    template <class Archive>
+    void serialize(Archive& ar) {
+        ar(cereal::make_nvp("type", _type), cereal::make_nvp("coordinates", _coordinates));
+    }
+
+   private:
+    void append_ring(const std::vector<geo_point>& points) {
+        std::vector<std::vector<double>> ring;
+        for (const auto& p : points) {
+            ring.push_back(p.coordinates());
+        }
+        if (!ring.empty() && ring.front() != ring.back()) {
+            ring.push_back(ring.front());
+        }
+        if (ring.size() < 4) {
+            throw std::logic_error("A polygon ring must have at least three distinct points.");
+        }
+        _coordinates.push_back(std::move(ring));
+    }
+
+    std::string _type = "Polygon";
+    std::vector<std::vector<std::vector<double>>> _coordinates;
+};
+
+/**
+ * A circle on a sphere, for $geoWithin queries with the $centerSphere operator. The radius is
+ * given in radians; use earth_radians() to convert a distance on Earth.
+ */
+struct geo_center_sphere {
+    geo_point center;
+    double radius;
+};
+
+/**
+ * Converts a distance on the surface of the Earth, in meters, to the angle in radians that
+ * $centerSphere expects.
+ */
+inline double earth_radians(double meters) {
+    return meters / 6378100.0;
+}
+
+/**
+ * Represents a geospatial query on a field, of the form "field: {<operator>: <operand>}", where
+ * the operand is a document such as {$geometry: <GeoJSON>, $maxDistance: <meters>} or
+ * {$centerSphere: ...}.
+ *
+ * These expressions are created by the geospatial methods of name-value pairs, e.g.
+ * MANGROVE_KEY(Restaurant::location).near(geo_point{-73.98, 40.75}, 500).
+ */
+template <typename NvpT>
+class geo_expr {
+   public:
+    using field_type = NvpT;
+
+    /**
+     * Constructs an expression whose operand is a GeoJSON object, for $near, $nearSphere,
+     * $geoWithin and $geoIntersects.
+     * @param  nvp           A name-value pair corresponding to a key in a document
+     * @param  op            The geospatial operator.
+     * @param  geometry      A GeoJSON object, e.g. a geo_point or a geo_polygon.
+     * @param  max_distance  For $near and $nearSphere, the maximum distance in meters, if any.
+     * @param  min_distance  For $near and $nearSphere, the minimum distance in meters, if any.
+     */
+    template <typename Geometry>
+    geo_expr(const NvpT& nvp, const char* op, const Geometry& geometry,
+             bsoncxx::stdx::optional<double> max_distance = {},
+             bsoncxx::stdx::optional<double> min_distance = {})
+        : _nvp(nvp), _operator(op) {
+        auto builder = bsoncxx::builder::core(false);
+        builder.key_view("$geometry");
+        append_value_to_bson(geometry, builder);
+        if (max_distance) {
+            builder.key_view("$maxDistance");
+            builder.append(*max_distance);
+        }
+        if (min_distance) {
+            builder.key_view("$minDistance");
+            builder.append(*min_distance);
+        }
+        _operand = builder.extract_document();
+    }
+
+    /**
+     * Constructs a $geoWithin expression with the $centerSphere operator.
+     */
+    geo_expr(const NvpT& nvp, const char* op, const geo_center_sphere& circle)
+        : _nvp(nvp), _operator(op) {
+        auto builder = bsoncxx::builder::core(false);
+        builder.key_view("$centerSphere");
+        builder.open_array();
+        append_value_to_bson(circle.center.coordinates(), builder);
+        builder.append(circle.radius);
+        builder.close_array();
+        _operand = builder.extract_document();
+    }
+
+    /**
+     * Appends the name of the contained field to a string.
+     */
+    std::string& append_name(std::string& s) const {
+        return _nvp.append_name(s);
+    }
+
+    /**
+     * Appends this expression to a BSON core builder, as a key-value pair of the form
+     * "key: {$op: operand}".
+     * @param builder   A BSON core builder
+     * @param wrap      Whether to wrap the BSON inside a document.
+     * @param omit_name Whether to skip the name of the field, and only append the operator.
+     */
+    void append_to_bson(bsoncxx::builder::core& builder, bool wrap = false,
+                        bool omit_name = false) const {
+        if (wrap) {
+            builder.open_document();
+        }
+        if (!omit_name) {
+            std::string s;
+            builder.key_view(_nvp.append_name(s));
+            builder.open_document();
+        }
+
+        builder.key_view(_operator);
+        builder.append(bsoncxx::types::b_document{_operand.view()});
+
+        if (!omit_name) {
+            builder.close_document();
+        }
+        if (wrap) {
+            builder.close_document();
+        }
+    }
+
+    /**
+     * Converts the expression to a BSON filter for a query.
+     * The format of the BSON is "{key: {$op: operand}}".
+     */
+    operator bsoncxx::document::view_or_value() const {
+        auto builder = bsoncxx::builder::core(false);
+        append_to_bson(builder);
+        return builder.extract_document();
+    }
+
+   private:
+    const NvpT _nvp;
+    const char* _operator;
+    bsoncxx::document::value _operand{bsoncxx::document::view{}};
+};
+
+/**
+ * Returns the keys of a 2dsphere index on a field holding GeoJSON objects, i.e. {field:
+ * "2dsphere"}. $near and $nearSphere queries on GeoJSON points require such an index, and it
+ * speeds up $geoWithin and $geoIntersects, e.g.
+ *
+ *     auto restaurants = Restaurant::collection();
+ *     restaurants.create_index(geo_index_keys(MANGROVE_KEY(Restaurant::location)));
+ */
+template <typename NvpT, typename = std::enable_if_t<is_nvp_v<NvpT>>>
+bsoncxx::document::value geo_index_keys(const NvpT& field) {
+    std::string name;
+    auto builder = bsoncxx::builder::core(false);
+    builder.key_owned(field.append_name(name));
+    builder.append("2dsphere");
+    return builder.extract_document();
+}
+
+MANGROVE_INLINE_NAMESPACE_END
+}  // namespace mangrove
+
+#include <mangrove/config/postlude.hpp>
@@ -0,0 +1,115 @@
+// Copyright 2016 MongoDB Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <mangrove/config/prelude.hpp>
+
+#include <iterator>
+#include <string>
+
+#include <bsoncxx/builder/core.hpp>
+#include <bsoncxx/document/value.hpp>
+#include <bsoncxx/document/view.hpp>
+#include <bsoncxx/stdx/optional.hpp>
+
+#include <mangrove/query_builder.hpp>
+
+namespace mangrove {
+MANGROVE_INLINE_NAMESPACE_BEGIN
+
+namespace details {
+
+/**
+ * Builds the filter {_id: id} for the given identifier. Any type that can be used as a model's
+ * _id can be passed here, since the value is appended in the same way the query builder appends
+ * values.
+ *
+ * @param id The identifier to match.
+ * @return A document of the form {_id: id}.
+ */
+template <typename IdType>
+bsoncxx::document::value id_filter(const IdType& id) {
+    auto builder = bsoncxx::builder::core(false);
+    builder.key_view("_id");
+    append_value_to_bson(id, builder);
+    return builder.extract_document();
+}
+
+/**
+ * Builds the filter {_id: {$in: [ids...]}} for the identifiers in the range [begin, end).
+ *
+ * @param begin Iterator pointing to the first identifier.
+ * @param end Iterator pointing past the last identifier.
+ * @return A document of the form {_id: {$in: [...]}}.
+ */
+template <typename Iterator>
+bsoncxx::document::value ids_in_filter(Iterator begin, Iterator end) {
+    auto builder = bsoncxx::builder::core(false);
+    builder.key_view("_id");
+    builder.open_document();
+    builder.key_view("$in");
+    builder.open_array();
+    for (; begin != end; ++begin) {
+        append_value_to_bson(*begin, builder);
+    }
+    builder.close_array();
+    builder.close_document();
+    return builder.extract_document();
+}
+
+/**
+ * Checks whether a query filter is a plain lookup by _id, i.e. of the form {_id: <value>} where
+ * value is not an operator document such as {$in: [...]}.
+ *
+ * @param filter A query filter.
+ * @return The canonical filter {_id: value} if the filter is a lookup by _id, or an empty optional
+ *         otherwise.
+ */
+inline bsoncxx::stdx::optional<bsoncxx::document::value> id_filter_from_query(
+    bsoncxx::document::view filter) {
+    auto it = filter.begin();
+    if (it == filter.end() || it->key() != bsoncxx::stdx::string_view{"_id"} ||
+        std::next(it) != filter.end()) {
+        return {};
+    }
+
+    auto id = it->get_value();
+    if (id.type() == bsoncxx::type::k_document) {
+        auto sub = id.get_document().value;
+        if (sub.begin() != sub.end() && !sub.begin()->key().empty() &&
+            sub.begin()->key()[0] == '$') {
+            return {};
+        }
+    } else if (id.type() == bsoncxx::type::k_regex) {
+        return {};
+    }
+
+    return id_filter(id);
+}
+
+/**
+ * Returns a string holding the raw bytes of a canonical {_id: value} filter, suitable as a key for
+ * hash maps of objects indexed by their identifier.
+ */
+inline std::string id_key(bsoncxx::document::view id_filter) {
+    return std::string(reinterpret_cast<const char*>(id_filter.data()), id_filter.length());
+}
+
+}  // namespace details
+
+MANGROVE_INLINE_NAMESPACE_END
+}  // namespace mangrove
+
+#include <mangrove/config/postlude.hpp>
@@ -0,0 +1,310 @@
+// Copyright 2016 MongoDB Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <mangrove/config/prelude.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <bsoncxx/builder/core.hpp>
+#include <bsoncxx/document/value.hpp>
+#include <bsoncxx/document/view.hpp>
+#include <bsoncxx/document/view_or_value.hpp>
+#include <bsoncxx/stdx/optional.hpp>
+#include <bsoncxx/types.hpp>
+#include <mongocxx/collection.hpp>
+
+#include <mangrove/expression_syntax.hpp>
+#include <mangrove/geo.hpp>
+#include <mangrove/nvp.hpp>
+#include <mangrove/query_builder.hpp>
+#include <mangrove/util.hpp>
+
+namespace mangrove {
+MANGROVE_INLINE_NAMESPACE_BEGIN
+
+/**
+ * The definition of an index: its keys, its name, and its options. Index specs are created with
+ * mangrove::index(), mangrove::text_index() or mangrove::geo_index(), and declared in a model with
+ * MANGROVE_INDEXES.
+ */
+class index_spec {
+   public:
+    /**
+     * Creates an index on the given keys. The name defaults to the one the server would give the
+     * index, e.g. "name_1_age_-1" for {name: 1, age: -1}.
+     */
+    explicit index_spec(bsoncxx::document::value keys) : _keys(std::move(keys)) {
+        for (auto&& elem : _keys.view()) {
+            if (!_name.empty()) {
+                _name += '_';
+            }
+            _name.append(elem.key().data(), elem.key().size()).append(1, '_');
+            if (elem.type() == bsoncxx::type::k_utf8) {
+                auto type = elem.get_utf8().value;
+                _name.append(type.data(), type.size());
+            } else if (elem.type() == bsoncxx::type::k_int32) {
+                _name += std::to_string(elem.get_int32().value);
+            } else if (elem.type() == bsoncxx::type::k_int64) {
+                _name += std::to_string(elem.get_int64().value);
+            } else {
+                _name += elem.get_double().value < 0 ? "-1" : "1";
+            }
+        }
+    }
+
+    /**
+     * Sets the name of the index.
+     */
+    index_spec& name(std::string name) {
+        _name = std::move(name);
+        return *this;
+    }
+
+    /**
+     * Makes the index unique, so that no two documents have the same values for its keys.
+     */
+    index_spec& unique(bool unique = true) {
+        _unique = unique;
+        return *this;
+    }
+
+    /**
+     * Makes this a TTL index, which deletes documents once the date stored in its (single) key
+     * is older than the given duration.
+     */
+    index_spec& expire_after(std::chrono::seconds duration) {
+        _expire_after = duration;
+        return *this;
+    }
+
+    /**
+     * Makes this a partial index, which only indexes the documents that match a query.
+     */
+    template <typename Expr, typename = std::enable_if_t<details::is_query_expression_v<Expr>>>
+    index_spec& partial(const Expr& filter) {
+        bsoncxx::document::view_or_value filter_doc = filter;
+        _partial_filter = bsoncxx::document::value{filter_doc.view()};
+        return *this;
+    }
+
+    const std::string& name() const {
+        return _name;
+    }
+
+    bsoncxx::document::view keys() const {
+        return _keys.view();
+    }
+
+    /**
+     * Returns the options to pass to mongocxx::collection::create_index().
+     */
+    bsoncxx::document::value options() const {
+        auto builder = bsoncxx::builder::core(false);
+        builder.key_view("name");
+        builder.append(_name);
+        if (_unique) {
+            builder.key_view("unique");
+            builder.append(true);
+        }
+        if (_expire_after) {
+            builder.key_view("expireAfterSeconds");
+            builder.append(static_cast<std::int32_t>(_expire_after->count()));
+        }
+        if (_partial_filter) {
+            builder.key_view("partialFilterExpression");
+            builder.append(bsoncxx::types::b_document{_partial_filter->view()});
+        }
+        return builder.extract_document();
+    }
+
+   private:
+    bsoncxx::document::value _keys;
+    std::string _name;
+    bool _unique = false;
+    bsoncxx::stdx::optional<std::chrono::seconds> _expire_after;
+    bsoncxx::stdx::optional<bsoncxx::document::value> _partial_filter;
+};
+
+namespace details {
+
+template <typename NvpT, typename = std::enable_if_t<is_nvp_v<NvpT>>>
+void append_index_key(bsoncxx::builder::core& builder, const NvpT& field) {
+    std::string name;
+    builder.key_owned(field.append_name(name));
+    builder.append(std::int32_t{1});
+}
+
+template <typename NvpT>
+void append_index_key(bsoncxx::builder::core& builder, const sort_expr<NvpT>& key) {
+    key.append_to_bson(builder);
+}
+
+}  // namespace details
+
+/**
+ * Creates a single-field or compound index. Every key is either a name-value pair, which is
+ * indexed in ascending order, or a sort expression giving its order, e.g.
+ *
+ *     mangrove::index(MANGROVE_KEY(User::country), MANGROVE_KEY(User::age).sort(false))
+ *
+ * yields the index {country: 1, age: -1}, named "country_1_age_-1".
+ */
+template <typename... Keys>
+index_spec index(const Keys&... keys) {
+    static_assert(sizeof...(Keys) > 0, "An index needs at least one key.");
+    auto builder = bsoncxx::builder::core(false);
+    tuple_for_each(std::forward_as_tuple(keys...),
+                   [&](const auto& key) { details::append_index_key(builder, key); });
+    return index_spec{builder.extract_document()};
+}
+
+/**
+ * Creates a text index on one or more string fields, for queries with mangrove::text().
+ */
+template <typename... Fields>
+index_spec text_index(const Fields&... fields) {
+    static_assert(sizeof...(Fields) > 0, "A text index needs at least one field.");
+    auto builder = bsoncxx::builder::core(false);
+    tuple_for_each(std::forward_as_tuple(fields...), [&](const auto& field) {
+        std::string name;
+        builder.key_owned(field.append_name(name));
+        builder.append("text");
+    });
+    return index_spec{builder.extract_document()};
+}
+
+/**
+ * Creates a 2dsphere index on a field holding GeoJSON objects, such as a geo_point.
+ */
+template <typename NvpT, typename = std::enable_if_t<is_nvp_v<NvpT>>>
+index_spec geo_index(const NvpT& field) {
+    return index_spec{geo_index_keys(field)};
+}
+
+namespace details {
+
+/**
+ * Type trait that checks whether a type declared indexes with MANGROVE_INDEXES.
+ */
+template <typename T, typename = void>
+struct has_declared_indexes : public std::false_type {};
+
+template <typename T>
+struct has_declared_indexes<T, decltype(void(T::mangrove_indexes()))> : public std::true_type {};
+
+template <typename T>
+std::enable_if_t<has_declared_indexes<T>::value, std::vector<index_spec>> declared_indexes() {
+    return T::mangrove_indexes();
+}
+
+template <typename T>
+std::enable_if_t<!has_declared_indexes<T>::value, std::vector<index_spec>> declared_indexes() {
+    return {};
+}
+
+// Returns true if two index key patterns have the same fields in the same order, and the same
+// directions or index types. Directions are compared by sign, since the server keeps whichever
+// numeric type the index was created with.
+inline bool same_index_keys(bsoncxx::document::view a, bsoncxx::document::view b) {
+    auto it = b.begin();
+    for (auto&& elem : a) {
+        if (it == b.end() || elem.key() != it->key()) {
+            return false;
+        }
+
+        auto lhs = elem.get_value();
+        auto rhs = it->get_value();
+        auto is_numeric = [](const bsoncxx::types::value& v) {
+            return v.type() == bsoncxx::type::k_int32 || v.type() == bsoncxx::type::k_int64 ||
+                   v.type() == bsoncxx::type::k_double;
+        };
+        auto sign = [](const bsoncxx::types::value& v) {
+            switch (v.type()) {
+                case bsoncxx::type::k_int32:
+                    return v.get_int32().value < 0 ? -1 : 1;
+                case bsoncxx::type::k_int64:
+                    return v.get_int64().value < 0 ? -1 : 1;
+                default:
+                    return v.get_double().value < 0 ? -1 : 1;
+            }
+        };
+
+        if (is_numeric(lhs) && is_numeric(rhs)) {
+            if (sign(lhs) != sign(rhs)) {
+                return false;
+            }
+        } else if (!(lhs == rhs)) {
+            return false;
+        }
+        ++it;
+    }
+    return it == b.end();
+}
+
+// Returns the indexes of a collection, as listed by the server.
+inline std::vector<index_spec> listed_indexes(mongocxx::collection& coll) {
+    std::vector<index_spec> indexes;
+    for (auto&& index : coll.list_indexes()) {
+        auto name = index["name"].get_utf8().value;
+        indexes.emplace_back(bsoncxx::document::value{index["key"].get_document().value});
+        indexes.back().name(std::string{name.data(), name.size()});
+    }
+    return indexes;
+}
+
+// Returns true if one of the given indexes has the same name or the same key pattern as spec.
+inline bool contains_index(const std::vector<index_spec>& indexes, const index_spec& spec) {
+    for (const auto& index : indexes) {
+        if (index.name() == spec.name() || same_index_keys(index.keys(), spec.keys())) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Creates the given indexes that don't exist on the collection yet. An index exists if the
+ * collection has an index with the same name, or with the same key pattern. Options are not
+ * compared, so changing the options of an existing index requires dropping it first.
+ *
+ * @return The names of the indexes that were created.
+ */
+inline std::vector<std::string> ensure_indexes(mongocxx::collection& coll,
+                                               const std::vector<index_spec>& specs) {
+    auto existing = listed_indexes(coll);
+
+    std::vector<std::string> created;
+    for (const auto& spec : specs) {
+        if (!contains_index(existing, spec)) {
+            coll.create_index(spec.keys(), spec.options());
+            created.push_back(spec.name());
+        }
+    }
+    return created;
+}
+
+}  // namespace details
+
+MANGROVE_INLINE_NAMESPACE_END
+}  // namespace mangrove
+
+#include <mangrove/config/postlude.hpp>
@@ -0,0 +1,279 @@
+// Copyright 2016 MongoDB Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <mangrove/config/prelude.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <bsoncxx/stdx/optional.hpp>
+
+namespace mangrove {
+MANGROVE_INLINE_NAMESPACE_BEGIN
+
+/**
+ * Options controlling the size and lifetime of entries in an lru_cache.
+ */
+struct cache_options {
+    /**
+     * How long an entry may be served from the cache after it was inserted.
+     */
+    std::chrono::milliseconds ttl = std::chrono::minutes(5);
+
+    /**
+     * The maximum number of bytes held by the cache, as measured by the sizes passed to put().
+     * The bound is enforced per shard, i.e. each shard may hold max_bytes / shards bytes.
+     */
+    std::size_t max_bytes = 64 * 1024 * 1024;
+
+    /**
+     * The number of independently locked shards. More shards reduce contention between threads
+     * accessing different keys.
+     */
+    std::size_t shards = 16;
+};
+
+/**
+ * A snapshot of the counters of an lru_cache.
+ */
+struct cache_statistics {
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+    std::uint64_t evictions = 0;
+    std::size_t entries = 0;
+    std::size_t bytes = 0;
+};
+
+/**
+ * A thread-safe, sharded, size-bounded LRU cache with a time-to-live for its entries.
+ *
+ * Keys are hashed onto a fixed number of shards, each protected by its own mutex, so that threads
+ * looking up different keys rarely contend with each other. Within a shard, entries are kept in
+ * least-recently-used order and evicted once the shard exceeds its share of the byte budget.
+ *
+ * A reader that fills the cache from a slower source should call generation() before reading
+ * the source, and pass the result to put(). If the key's shard was invalidated in between, by
+ * erase() or clear(), the value may be stale and put() discards it.
+ *
+ * @tparam Value The type of the cached values. Values are copied out of the cache on lookup.
+ */
+template <typename Value>
+class lru_cache {
+   public:
+    explicit lru_cache(const cache_options& options = cache_options())
+        : _ttl(options.ttl),
+          _shard_max_bytes(options.max_bytes / (options.shards ? options.shards : 1)),
+          _shards(options.shards ? options.shards : 1) {
+    }
+
+    lru_cache(const lru_cache&) = delete;
+    lru_cache& operator=(const lru_cache&) = delete;
+
+    /**
+     * Looks up a key, refreshing its position in the LRU order.
+     *
+     * @param key The key to look up.
+     *
+     * @return A copy of the cached value, or an empty optional if the key is not cached or its
+     *         entry has expired.
+     */
+    bsoncxx::stdx::optional<Value> get(const std::string& key) {
+        auto& s = shard_for(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+
+        auto it = s.index.find(key);
+        if (it == s.index.end()) {
+            _misses.fetch_add(1, std::memory_order_relaxed);
+            return {};
+        }
+
+        if (it->second->expires < clock::now()) {
+            s.bytes -= it->second->bytes;
+            s.entries.erase(it->second);
+            s.index.erase(it);
+            _misses.fetch_add(1, std::memory_order_relaxed);
+            return {};
+        }
+
+        s.entries.splice(s.entries.begin(), s.entries, it->second);
+        _hits.fetch_add(1, std::memory_order_relaxed);
+        return it->second->value;
+    }
+
+    /**
+     * Inserts or replaces the value for a key, evicting the least recently used entries of the
+     * shard if it exceeds its byte budget. Values larger than a shard's budget are not cached.
+     *
+     * @param key The key to store the value under.
+     * @param value The value to cache.
+     * @param bytes The approximate size of the value, used to enforce the byte bound.
+     */
+    void put(const std::string& key, Value value, std::size_t bytes) {
+        if (bytes > _shard_max_bytes) {
+            return;
+        }
+
+        auto& s = shard_for(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        insert(s, key, std::move(value), bytes);
+    }
+
+    /**
+     * Inserts or replaces the value for a key like put(key, value, bytes), unless the shard of
+     * the key was invalidated by erase() or clear() since generation(key) returned generation.
+     * In that case the value was read before the invalidation and may be stale, so it is
+     * discarded.
+     *
+     * @return Whether the value was inserted.
+     */
+    bool put(const std::string& key, Value value, std::size_t bytes, std::uint64_t generation) {
+        if (bytes > _shard_max_bytes) {
+            return false;
+        }
+
+        auto& s = shard_for(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        if (s.generation != generation) {
+            return false;
+        }
+
+        insert(s, key, std::move(value), bytes);
+        return true;
+    }
+
+    /**
+     * Returns the invalidation generation of the shard of a key, which erase() and clear()
+     * increment. See put(key, value, bytes, generation).
+     */
+    std::uint64_t generation(const std::string& key) {
+        auto& s = shard_for(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        return s.generation;
+    }
+
+    /**
+     * Removes the entry for a key, if there is one.
+     */
+    void erase(const std::string& key) {
+        auto& s = shard_for(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        ++s.generation;
+
+        auto it = s.index.find(key);
+        if (it != s.index.end()) {
+            s.bytes -= it->second->bytes;
+            s.entries.erase(it->second);
+            s.index.erase(it);
+        }
+    }
+
+    /**
+     * Removes every entry from the cache. The hit, miss and eviction counters are not reset.
+     */
+    void clear() {
+        for (auto& s : _shards) {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            ++s.generation;
+            s.index.clear();
+            s.entries.clear();
+            s.bytes = 0;
+        }
+    }
+
+    /**
+     * Returns a snapshot of the cache's counters and current size.
+     */
+    cache_statistics stats() const {
+        cache_statistics result;
+        result.hits = _hits.load(std::memory_order_relaxed);
+        result.misses = _misses.load(std::memory_order_relaxed);
+        result.evictions = _evictions.load(std::memory_order_relaxed);
+
+        for (auto& s : _shards) {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            result.entries += s.entries.size();
+            result.bytes += s.bytes;
+        }
+
+        return result;
+    }
+
+   private:
+    using clock = std::chrono::steady_clock;
+
+    struct node {
+        std::string key;
+        Value value;
+        std::size_t bytes;
+        clock::time_point expires;
+    };
+
+    struct shard {
+        mutable std::mutex mutex;
+        std::list<node> entries;
+        std::unordered_map<std::string, typename std::list<node>::iterator> index;
+        std::size_t bytes = 0;
+        std::uint64_t generation = 0;
+    };
+
+    // Inserts a value into a shard whose mutex is held, evicting entries over the byte budget.
+    void insert(shard& s, const std::string& key, Value value, std::size_t bytes) {
+        auto it = s.index.find(key);
+        if (it != s.index.end()) {
+            s.bytes -= it->second->bytes;
+            s.entries.erase(it->second);
+            s.index.erase(it);
+        }
+
+        s.entries.push_front(node{key, std::move(value), bytes, clock::now() + _ttl});
+        s.index.emplace(key, s.entries.begin());
+        s.bytes += bytes;
+
+        while (s.bytes > _shard_max_bytes) {
+            auto& last = s.entries.back();
+            s.bytes -= last.bytes;
+            s.index.erase(last.key);
+            s.entries.pop_back();
+            _evictions.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    shard& shard_for(const std::string& key) {
+        return _shards[std::hash<std::string>{}(key) % _shards.size()];
+    }
+
+    const clock::duration _ttl;
+    const std::size_t _shard_max_bytes;
+    std::vector<shard> _shards;
+
+    std::atomic<std::uint64_t> _hits{0};
+    std::atomic<std::uint64_t> _misses{0};
+    std::atomic<std::uint64_t> _evictions{0};
+};
+
+MANGROVE_INLINE_NAMESPACE_END
+}  // namespace mangrove
+
+#include <mangrove/config/postlude.hpp>
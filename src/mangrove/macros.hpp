@@ -55,6 +55,31 @@
 // If using the mangrove::model, then also register _id as a field.
 #define MANGROVE_MAKE_KEYS_MODEL(Base, ...) MANGROVE_MAKE_KEYS(Base, MANGROVE_NVP(_id), __VA_ARGS__)
 
+// Declare the indexes of a model, which model::ensure_indexes() creates. Every argument is an
+// index_spec, e.g. mangrove::index(MANGROVE_KEY(User::email)).unique().
+#define MANGROVE_INDEXES(...)                                     \
+    static std::vector<mangrove::index_spec> mangrove_indexes() { \
+        return {__VA_ARGS__};                                     \
+    }
+
+// Register members under short keys assigned by their position ("a", "b", ...), and create
+// serialize() function. Queries, updates, sorts and projections built from the registered fields
+// use the short keys automatically. Since the keys are positional, new fields must be appended,
+// and registered fields must never be reordered or removed.
+#define MANGROVE_MAKE_KEYS_COMPACT(Base, ...)                        \
+    using mangrove_wrap_base = Base;                                 \
+    constexpr static auto mangrove_field_names() {                   \
+        return std::make_tuple(__VA_ARGS__);                         \
+    }                                                                \
+    constexpr static auto mangrove_mapped_fields() {                 \
+        return mangrove::compact_fields(mangrove_field_names());     \
+    }                                                                \
+    MANGROVE_SERIALIZE_KEYS
+
+// Compact version of MANGROVE_MAKE_KEYS_MODEL. The _id field keeps its name.
+#define MANGROVE_MAKE_KEYS_MODEL_COMPACT(Base, ...) \
+    MANGROVE_MAKE_KEYS_COMPACT(Base, __VA_ARGS__, MANGROVE_NVP(_id))
+
 #define MANGROVE_KEY(value) mangrove::hasCallIfFieldIsPresent<decltype(&value), &value>::call()
 // convenience macro for accessing scalar elements of array fields in query builder.
 #define MANGROVE_ELEM(value) MANGROVE_KEY(value).element()
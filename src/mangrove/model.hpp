@@ -14,20 +14,71 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
 #include <cereal/cereal.hpp>
 
 #include <bsoncxx/oid.hpp>
 #include <mangrove/collection_wrapper.hpp>
 #include <mangrove/config/prelude.hpp>
+#include <mangrove/field_access.hpp>
+#include <mangrove/id_filter.hpp>
+#include <mangrove/index.hpp>
+#include <mangrove/lru_cache.hpp>
+#include <mangrove/oid_range.hpp>
+#include <mangrove/paginator.hpp>
+#include <mangrove/partition.hpp>
+#include <mangrove/pipeline_builder.hpp>
+#include <mangrove/query_cache.hpp>
+#include <mangrove/query_recorder.hpp>
+#include <mangrove/query_shape.hpp>
+#include <mangrove/sequence.hpp>
+#include <mangrove/single_flight.hpp>
+#include <mangrove/update_pipeline.hpp>
 #include <mangrove/util.hpp>
 #include <mongocxx/collection.hpp>
+#include <mongocxx/config/version.hpp>
+#include <mongocxx/pool.hpp>
 
 namespace mangrove {
 MANGROVE_INLINE_NAMESPACE_BEGIN
 
+template <typename T, typename IdType>
+class unit_of_work;
+
+/**
+ * Options for model operations that split their work into several queries.
+ */
+struct batch_options {
+    /**
+     * The maximum number of items handled by a single query.
+     */
+    std::size_t chunk_size = 1000;
+
+    /**
+     * The maximum number of queries that are run concurrently. Values greater than 1 only take
+     * effect once a client pool has been provided with model::set_pool().
+     */
+    std::size_t max_parallelism = 1;
+};
+
 template <typename T, typename IdType = bsoncxx::oid>
 class model {
    private:
+    friend class unit_of_work<T, IdType>;
+    template <typename, typename...>
+    friend class paginator;
+
 // TODO: When XCode 8 is released, this can always be thread_local. Until then, the model class
 //       will not be thread-safe on OS X.
 #ifdef __APPLE__
@@ -36,6 +87,342 @@ class model {
     static thread_local collection_wrapper<T> _coll;
 #endif
 
+    // The process-wide cache of objects by _id, shared by all threads. Null when caching is
+    // disabled. Always accessed through std::atomic_load and std::atomic_store.
+    static std::shared_ptr<lru_cache<T>> _cache;
+
+    // The process-wide cache of find_cached() results. Null when query caching is disabled.
+    static std::shared_ptr<query_cache<T>> _query_cache;
+
+    // The reads currently in flight, shared between threads issuing identical queries. Null when
+    // request coalescing is disabled.
+    struct in_flight_calls {
+        single_flight<mongocxx::stdx::optional<T>> find_one;
+        single_flight<std::shared_ptr<const std::vector<T>>> find_cached;
+    };
+    static std::shared_ptr<in_flight_calls> _in_flight;
+
+    // Records the field accesses of objects read through find() and find_one(). Null when
+    // tracking is disabled.
+    static std::shared_ptr<field_access_tracker> _field_access;
+
+    // Records the shapes of the queries made through this class. Null when recording is
+    // disabled.
+    static std::shared_ptr<query_recorder> _query_recorder;
+
+    // Whether reads are projected onto the fields of their result type, see
+    // set_auto_projection().
+    static std::atomic<bool> _auto_projection;
+
+    // Returns the calling thread's collection, with the process-wide projection setting applied.
+    static collection_wrapper<T>& wrapper() {
+        _coll.set_auto_projection(_auto_projection.load(std::memory_order_relaxed));
+        return _coll;
+    }
+
+    // The client pool used by operations that run queries on several threads, as set by
+    // set_pool(). Null if no pool was set.
+    struct pool_binding {
+        mongocxx::pool* pool;
+        std::string db_name;
+        std::string coll_name;
+    };
+    static std::shared_ptr<const pool_binding> _pool;
+
+    // The sequence from which integer _ids are assigned on insertion, as set by
+    // set_id_sequence(). Null if ids are assigned by the application.
+    static std::shared_ptr<id_sequence> _id_sequence;
+
+    // Assigns the next id of the sequence to an object whose _id is still zero.
+    template <typename Id = IdType>
+    static std::enable_if_t<std::is_integral<Id>::value> assign_id(
+        T& obj, const std::shared_ptr<id_sequence>& sequence) {
+        if (sequence && obj._id == 0) {
+            obj._id = static_cast<IdType>(sequence->next());
+        }
+    }
+
+    template <typename Id = IdType>
+    static std::enable_if_t<!std::is_integral<Id>::value> assign_id(
+        T&, const std::shared_ptr<id_sequence>&) {
+    }
+
+    // Assigns ids to the objects of a range in place, so that the caller's objects get them.
+    template <typename object_iterator_type>
+    static mongocxx::stdx::optional<mongocxx::result::insert_many> insert_many_with_ids(
+        object_iterator_type begin, object_iterator_type end,
+        const mongocxx::options::insert& options, const std::shared_ptr<id_sequence>& sequence,
+        std::true_type) {
+        for (auto it = begin; it != end; ++it) {
+            assign_id(*it, sequence);
+        }
+        return _coll.insert_many(begin, end, options);
+    }
+
+    // Assigns ids to copies of the objects of a range that can't be modified, or only be
+    // traversed once.
+    template <typename object_iterator_type>
+    static mongocxx::stdx::optional<mongocxx::result::insert_many> insert_many_with_ids(
+        object_iterator_type begin, object_iterator_type end,
+        const mongocxx::options::insert& options, const std::shared_ptr<id_sequence>& sequence,
+        std::false_type) {
+        std::vector<T> objects(begin, end);
+        for (auto& obj : objects) {
+            assign_id(obj, sequence);
+        }
+        return _coll.insert_many(objects.begin(), objects.end(), options);
+    }
+
+    // Runs task(coll, i) for every i in [0, n). If a pool was set, the tasks are spread over up to
+    // max_parallelism threads, each using its own client from the pool. Otherwise they are run
+    // sequentially on the calling thread's collection. Exceptions thrown by the tasks are
+    // rethrown once every thread has finished.
+    template <typename Task>
+    static void run_partitioned(std::size_t n, std::size_t max_parallelism, const Task& task) {
+        auto binding = std::atomic_load(&_pool);
+        auto n_threads = std::min(n, max_parallelism);
+
+        if (!binding || n_threads < 2) {
+            auto coll = _coll.collection();
+            for (std::size_t i = 0; i < n; ++i) {
+                task(coll, i);
+            }
+            return;
+        }
+
+        std::atomic<std::size_t> next{0};
+        auto worker = [&] {
+            auto client = binding->pool->acquire();
+            auto coll = (*client)[binding->db_name][binding->coll_name];
+            for (auto i = next.fetch_add(1); i < n; i = next.fetch_add(1)) {
+                task(coll, i);
+            }
+        };
+
+        std::vector<std::future<void>> workers;
+        for (std::size_t i = 0; i < n_threads; ++i) {
+            workers.push_back(std::async(std::launch::async, worker));
+        }
+        for (auto& w : workers) {
+            w.wait();
+        }
+        for (auto& w : workers) {
+            w.get();
+        }
+    }
+
+    // Calls callback(obj) for every object matching the filter. The documents are split into
+    // about n_partitions ranges of the given key, which are scanned concurrently as by
+    // run_partitioned().
+    template <typename Callback>
+    static void scan_partitions(const std::string& key, bsoncxx::document::view filter,
+                                std::size_t n_partitions, const Callback& callback,
+                                const mongocxx::options::find& options) {
+        auto coll = _coll.collection();
+        auto split_points = details::partition_split_points(coll, filter, key, n_partitions);
+        auto points = split_points.view();
+        auto n_ranges = static_cast<std::size_t>(std::distance(points.begin(), points.end())) + 1;
+
+        // The projection depends on the calling thread's settings, so it is computed here.
+        auto find_options = wrapper().projected(options);
+
+        run_partitioned(n_ranges, n_partitions, [&](mongocxx::collection& c, std::size_t i) {
+            auto range = details::partition_filter(filter, key, points, i);
+            for (auto&& doc : c.find(range.view(), find_options)) {
+                callback(boson::to_obj<T>(doc));
+            }
+        });
+    }
+
+    // Runs op(), and records it under the shape of its query if query recording is enabled.
+    template <typename Op>
+    static auto recorded(const char* operation, bsoncxx::document::view filter,
+                         bsoncxx::document::view sort, const Op& op) -> decltype(op()) {
+        auto recorder = std::atomic_load(&_query_recorder);
+        return details::record_query(recorder.get(), operation, filter, sort, op);
+    }
+
+    // Implements find() and paginate(), which record their calls.
+    template <typename Result = T>
+    static deserializing_cursor<Result> unrecorded_find(bsoncxx::document::view_or_value filter,
+                                                        const mongocxx::options::find& options) {
+        auto tracker = std::atomic_load(&_field_access);
+        if (!tracker) {
+            return wrapper().template find<Result>(std::move(filter), options);
+        }
+
+        auto shape = tracker->shape_for("find " + query_shape(filter.view(), options));
+        return deserializing_cursor<Result>(
+            _coll.collection().find(filter.view(), wrapper().template projected<Result>(options)),
+            std::move(shape));
+    }
+
+    // Fetches a page for mangrove::paginator, and records it as a "paginate" query.
+    static std::vector<T> find_page(bsoncxx::document::view filter,
+                                    const mongocxx::options::find& options) {
+        return recorded("paginate", filter, details::sort_of(options), [&] {
+            std::vector<T> objs;
+            for (auto&& obj : unrecorded_find(filter, options)) {
+                objs.push_back(std::move(obj));
+            }
+            return objs;
+        });
+    }
+
+    // Implements find_by_ids(), which records the call.
+    template <typename Range>
+    static std::vector<mongocxx::stdx::optional<T>> lookup_by_ids(const Range& ids,
+                                                                  const batch_options& options) {
+        auto cache = std::atomic_load(&_cache);
+
+        std::vector<mongocxx::stdx::optional<T>> results;
+        std::unordered_map<std::string, std::vector<std::size_t>> positions;
+        std::unordered_map<std::string, std::uint64_t> generations;
+        std::vector<IdType> pending;
+
+        for (const auto& id : ids) {
+            auto key = details::id_key(details::id_filter(id).view());
+            auto& p = positions[key];
+            p.push_back(results.size());
+            results.emplace_back();
+
+            if (p.size() > 1) {
+                continue;
+            }
+
+            if (cache) {
+                generations[key] = cache->generation(key);
+                results.back() = cache->get(key);
+            }
+            if (!results.back()) {
+                pending.push_back(id);
+            }
+        }
+
+        auto find_options = wrapper().projected(mongocxx::options::find{});
+        auto chunk_size = std::max<std::size_t>(options.chunk_size, 1);
+        auto n_chunks = (pending.size() + chunk_size - 1) / chunk_size;
+
+        auto fetch_chunk = [&](mongocxx::collection& coll, std::size_t chunk) {
+            auto begin = pending.begin() + chunk * chunk_size;
+            auto end = pending.begin() + std::min((chunk + 1) * chunk_size, pending.size());
+            auto filter = details::ids_in_filter(begin, end);
+
+            for (auto&& doc : coll.find(filter.view(), find_options)) {
+                auto id = doc["_id"];
+                if (!id) {
+                    continue;
+                }
+
+                auto key = details::id_key(details::id_filter(id.get_value()).view());
+                auto it = positions.find(key);
+                if (it == positions.end()) {
+                    continue;
+                }
+
+                auto obj = boson::to_obj<T>(doc);
+                if (cache) {
+                    cache->put(key, obj, doc.length(), generations.at(key));
+                }
+                results[it->second.front()] = std::move(obj);
+            }
+        };
+
+        run_partitioned(n_chunks, options.max_parallelism, fetch_chunk);
+
+        for (const auto& kv : positions) {
+            for (std::size_t i = 1; i < kv.second.size(); ++i) {
+                results[kv.second[i]] = results[kv.second.front()];
+            }
+        }
+
+        return results;
+    }
+
+    // Implements find_one(), which records the call.
+    static mongocxx::stdx::optional<T> lookup_one(bsoncxx::document::view filter,
+                                                  const mongocxx::options::find& options) {
+        auto cache = std::atomic_load(&_cache);
+
+        mongocxx::stdx::optional<bsoncxx::document::value> by_id;
+        if (cache && !options.projection()) {
+            by_id = details::id_filter_from_query(filter);
+        }
+
+        // The generation is captured before the read, so that an invalidation made while the
+        // document is fetched keeps it from being cached.
+        std::string key;
+        std::uint64_t generation = 0;
+        if (by_id) {
+            key = details::id_key(by_id->view());
+            generation = cache->generation(key);
+            if (auto cached = cache->get(key)) {
+                return cached;
+            }
+        }
+
+        auto tracker = std::atomic_load(&_field_access);
+
+        auto fetch = [&]() -> mongocxx::stdx::optional<T> {
+            if (!by_id && !tracker) {
+                return wrapper().find_one(filter, options);
+            }
+
+            auto doc = _coll.collection().find_one(by_id ? by_id->view() : filter,
+                                                   wrapper().projected(options));
+            if (!doc) {
+                return {};
+            }
+
+            auto obj =
+                tracker
+                    ? tracker->shape_for("find_one " + query_shape(filter, options))
+                          ->template decode<T>(doc->view())
+                    : boson::to_obj<T>(doc->view());
+            if (by_id) {
+                cache->put(key, obj, doc->view().length(), generation);
+            }
+            return {std::move(obj)};
+        };
+
+        auto in_flight = std::atomic_load(&_in_flight);
+        if (!in_flight) {
+            return fetch();
+        }
+
+        return in_flight->find_one.run(details::find_cache_key(filter, options), fetch);
+    }
+
+    // Makes every cached query result stale. Called after every write made through this class.
+    static void bump_query_epoch() {
+        if (auto cache = std::atomic_load(&_query_cache)) {
+            cache->bump_epoch();
+        }
+    }
+
+    static void invalidate_cached_id(const std::string& key) {
+        bump_query_epoch();
+        if (auto cache = std::atomic_load(&_cache)) {
+            cache->erase(key);
+        }
+    }
+
+    // Invalidates the cached objects that a write with the given filter may have modified.
+    static void invalidate_cached(bsoncxx::document::view filter) {
+        bump_query_epoch();
+
+        auto cache = std::atomic_load(&_cache);
+        if (!cache) {
+            return;
+        }
+
+        if (auto by_id = details::id_filter_from_query(filter)) {
+            cache->erase(details::id_key(by_id->view()));
+        } else {
+            cache->clear();
+        }
+    }
+
    public:
     /**
      * Forward the arguments to the constructor of IdType.
@@ -53,6 +440,8 @@ class model {
 
     model() = default;
 
+    using id_type = IdType;
+
     /**
      * Counts the number of documents matching the provided filter.
      *
@@ -71,7 +460,195 @@ class model {
     static std::int64_t count(
         bsoncxx::document::view_or_value filter = bsoncxx::document::view_or_value{},
         const mongocxx::options::count& options = mongocxx::options::count()) {
-        return _coll.collection().count(filter, options);
+        return recorded("count", filter.view(), {},
+                        [&] { return _coll.collection().count(filter.view(), options); });
+    }
+
+    /**
+     * Enables the process-wide read-through cache for lookups by _id.
+     *
+     * Once enabled, find_one() calls whose filter is of the form {_id: <value>} and find_by_id()
+     * calls are served from an in-memory LRU cache shared by all threads, and only go to the
+     * database on a miss. Writes made through this class invalidate the affected entries. Writes
+     * made by other processes or directly through the underlying collection are only picked up
+     * once the cached entry expires.
+     *
+     * Calling this again replaces the existing cache with an empty one.
+     *
+     * @param options
+     *   The TTL, byte bound and number of shards of the cache, see mangrove::cache_options.
+     */
+    static void enable_cache(const cache_options& options = cache_options()) {
+        std::atomic_store(&_cache, std::make_shared<lru_cache<T>>(options));
+    }
+
+    /**
+     * Disables and discards the process-wide cache for lookups by _id.
+     */
+    static void disable_cache() {
+        std::atomic_store(&_cache, std::shared_ptr<lru_cache<T>>{});
+    }
+
+    /**
+     * Returns the hit, miss and eviction counters and the current size of the process-wide cache.
+     * All counters are zero if the cache is disabled.
+     */
+    static cache_statistics cache_stats() {
+        auto cache = std::atomic_load(&_cache);
+        return cache ? cache->stats() : cache_statistics{};
+    }
+
+    /**
+     * Enables request coalescing for find_one(), find_by_id() and find_cached().
+     *
+     * While a query is in flight, other threads issuing a query with identical filter and options
+     * wait for it and share its result instead of sending their own. This flattens bursts of
+     * identical reads, e.g. when a hot cached entry expires. All threads are assumed to map this
+     * class to the same collection.
+     */
+    static void enable_request_coalescing() {
+        std::atomic_store(&_in_flight, std::make_shared<in_flight_calls>());
+    }
+
+    /**
+     * Disables request coalescing. Queries already in flight are unaffected.
+     */
+    static void disable_request_coalescing() {
+        std::atomic_store(&_in_flight, std::shared_ptr<in_flight_calls>{});
+    }
+
+    /**
+     * Enables the process-wide cache of find_cached() results.
+     *
+     * Results are cached under the BSON of the query's filter and options, and every write made
+     * through this class makes all of them stale. As with enable_cache(), writes made by other
+     * processes are only picked up once the cached entry expires.
+     *
+     * @param options
+     *   The TTL, byte bound and number of shards of the cache, see mangrove::cache_options.
+     */
+    static void enable_query_cache(const cache_options& options = cache_options()) {
+        std::atomic_store(&_query_cache, std::make_shared<query_cache<T>>(options));
+    }
+
+    /**
+     * Disables and discards the process-wide cache of find_cached() results.
+     */
+    static void disable_query_cache() {
+        std::atomic_store(&_query_cache, std::shared_ptr<query_cache<T>>{});
+    }
+
+    /**
+     * Returns the counters and current size of the query result cache. All counters are zero if
+     * the cache is disabled.
+     */
+    static cache_statistics query_cache_stats() {
+        auto cache = std::atomic_load(&_query_cache);
+        return cache ? cache->stats() : cache_statistics{};
+    }
+
+    /**
+     * Enables field access tracking for objects read through find() and find_one().
+     *
+     * While enabled, every document read by these methods is recorded under the shape of its
+     * query (see mangrove::query_shape()), together with which of its top-level fields were used.
+     * Actual reads are only observed for boson::lazy and boson::lazy_vector members, which count
+     * as read once they are accessed. Other fields count as read whenever T maps them, so for
+     * them the report only shows the unmapped fields that queries fetch. Declare the heavy fields
+     * of T as lazy members while tracking to find out which of them are never read; the report
+     * suggests a projection for every query that fetches fields that are never used.
+     *
+     * Tracking adds bookkeeping to every read, so it is meant for profiling rather than for
+     * production use. Calling this again discards the statistics recorded so far.
+     */
+    static void enable_field_access_tracking() {
+        std::atomic_store(&_field_access, std::make_shared<field_access_tracker>());
+    }
+
+    /**
+     * Disables field access tracking and discards the statistics recorded so far.
+     */
+    static void disable_field_access_tracking() {
+        std::atomic_store(&_field_access, std::shared_ptr<field_access_tracker>{});
+    }
+
+    /**
+     * Returns the field usage recorded for every query shape since tracking was enabled, see
+     * enable_field_access_tracking(). Empty if tracking is disabled.
+     */
+    static std::vector<field_access_report> field_usage_report() {
+        auto tracker = std::atomic_load(&_field_access);
+        return tracker ? tracker->report() : std::vector<field_access_report>{};
+    }
+
+    /**
+     * Enables the recording of the queries made through this class: find(), find_one(),
+     * find_cached(), find_by_ids(), find_values(), distinct(), paginate(), count(),
+     * update_many(), update_one(), delete_many(), delete_one(), find_one_and_update(), save()
+     * and remove(). Lookups served from the caches are recorded too.
+     *
+     * Every query is recorded under its operation and shape (see mangrove::query_shape()), with
+     * its latency. The recorded shapes can then be compared with the indexes of the collection by
+     * advise_indexes(). Calling this again discards the queries recorded so far.
+     */
+    static void enable_query_recording() {
+        std::atomic_store(&_query_recorder, std::make_shared<query_recorder>());
+    }
+
+    /**
+     * Disables query recording and discards the queries recorded so far.
+     */
+    static void disable_query_recording() {
+        std::atomic_store(&_query_recorder, std::shared_ptr<query_recorder>{});
+    }
+
+    /**
+     * Returns the statistics of every query shape recorded since recording was enabled, see
+     * enable_query_recording(). Empty if recording is disabled.
+     */
+    static std::vector<recorded_query> recorded_queries() {
+        auto recorder = std::atomic_load(&_query_recorder);
+        return recorder ? recorder->queries() : std::vector<recorded_query>{};
+    }
+
+    /**
+     * Compares the recorded queries with the indexes listed by the server and the indexes
+     * declared with MANGROVE_INDEXES, to report the missing and unused indexes. See
+     * mangrove::advise_indexes().
+     *
+     * @throws mongocxx::exception::operation if the indexes can't be listed.
+     */
+    static index_report advise_indexes() {
+        auto coll = _coll.collection();
+        auto indexes = details::listed_indexes(coll);
+        for (auto& spec : declared_indexes()) {
+            if (!details::contains_index(indexes, spec)) {
+                indexes.push_back(std::move(spec));
+            }
+        }
+        return mangrove::advise_indexes(recorded_queries(), indexes);
+    }
+
+    /**
+     * Returns the indexes that T declares with MANGROVE_INDEXES, or an empty list if it declares
+     * none.
+     */
+    static std::vector<index_spec> declared_indexes() {
+        return details::declared_indexes<T>();
+    }
+
+    /**
+     * Creates the declared indexes (see MANGROVE_INDEXES) that the collection doesn't have yet.
+     * The indexes listed by the server are compared with the declared ones by name and by key
+     * pattern, so indexes created by hand under other names are not duplicated. This is meant to
+     * be called once at startup, after setCollection().
+     *
+     * @return The names of the indexes that were created.
+     * @throws mongocxx::exception::operation if the indexes can't be listed or created.
+     */
+    static std::vector<std::string> ensure_indexes() {
+        auto coll = _coll.collection();
+        return details::ensure_indexes(coll, declared_indexes());
     }
 
     /**
@@ -100,7 +677,11 @@ class model {
     static mongocxx::stdx::optional<mongocxx::result::delete_result> delete_many(
         bsoncxx::document::view_or_value filter,
         const mongocxx::options::delete_options& options = mongocxx::options::delete_options()) {
-        return _coll.collection().delete_many(filter, options);
+        auto result = recorded("delete_many", filter.view(), {}, [&] {
+            return _coll.collection().delete_many(filter.view(), options);
+        });
+        invalidate_cached(filter.view());
+        return result;
     }
 
     /**
@@ -119,7 +700,11 @@ class model {
     static mongocxx::stdx::optional<mongocxx::result::delete_result> delete_one(
         bsoncxx::document::view_or_value filter,
         const mongocxx::options::delete_options& options = mongocxx::options::delete_options()) {
-        return _coll.collection().delete_one(filter, options);
+        auto result = recorded("delete_one", filter.view(), {}, [&] {
+            return _coll.collection().delete_one(filter.view(), options);
+        });
+        invalidate_cached(filter.view());
+        return result;
     }
 
     /**
@@ -131,11 +716,19 @@ class model {
      */
     static void drop() {
         _coll.collection().drop();
+        bump_query_epoch();
+        if (auto cache = std::atomic_load(&_cache)) {
+            cache->clear();
+        }
     }
 
     /**
      * Finds the documents in this collection which match the provided filter.
      *
+     * @tparam Result
+     *   The type that the documents are deserialized into. Defaults to the model class itself,
+     *   but may be a lighter view type that maps only some of its fields. With automatic
+     *   projection (see set_auto_projection()), only those fields are fetched.
      * @param filter
      *   Document view representing a document that should match the query.
      * @param options
@@ -148,15 +741,178 @@ class model {
      *
      * @see https://docs.mongodb.com/manual/tutorial/query-documents/
      */
-    static deserializing_cursor<T> find(
+    template <typename Result = T>
+    static deserializing_cursor<Result> find(
         bsoncxx::document::view_or_value filter,
         const mongocxx::options::find& options = mongocxx::options::find()) {
-        return _coll.find(std::move(filter), options);
+        if (auto recorder = std::atomic_load(&_query_recorder)) {
+            recorder->record("find", filter.view(), details::sort_of(options));
+        }
+        return unrecorded_find<Result>(std::move(filter), options);
+    }
+
+    /**
+     * Runs an aggregation pipeline against this collection, and returns the results as
+     * deserialized objects. The pipeline may be built with mangrove::pipeline_builder.
+     *
+     * @tparam Result
+     *   The type that the output documents are deserialized into. Defaults to the model class.
+     * @param pipeline
+     *   The pipeline of aggregation operations to perform.
+     * @param options
+     *   Optional arguments, see mongocxx::options::aggregate.
+     *
+     * @return Cursor with the deserialized output documents.
+     * @throws
+     *   If the operation failed, the returned cursor will throw mongocxx::exception::query when
+     *   it is iterated.
+     *
+     * @warning Writes made by $out or $merge stages are not reflected in the caches of this class.
+     *
+     * @see https://docs.mongodb.com/manual/reference/command/aggregate/
+     */
+    template <typename Result = T>
+    static deserializing_cursor<Result> aggregate(
+        const mongocxx::pipeline& pipeline,
+        const mongocxx::options::aggregate& options = mongocxx::options::aggregate()) {
+        return wrapper().template aggregate<Result>(pipeline, options);
+    }
+
+    /**
+     * Finds the documents in this collection which match the provided filter, and returns all of
+     * them as deserialized objects.
+     *
+     * If the query cache is enabled (see enable_query_cache()), identical queries are answered
+     * from memory until the next write made through this class. If request coalescing is enabled
+     * (see enable_request_coalescing()), concurrent identical queries share one round-trip.
+     *
+     * @param filter
+     *   Document view representing a document that should match the query.
+     * @param options
+     *   Optional arguments, see mongocxx::options::find
+     *
+     * @return A shared, immutable vector of the deserialized objects.
+     * @throws mongocxx::exception::query if the operation fails.
+     */
+    static std::shared_ptr<const std::vector<T>> find_cached(
+        bsoncxx::document::view_or_value filter,
+        const mongocxx::options::find& options = mongocxx::options::find()) {
+        auto fetch = [&] {
+            auto cache = std::atomic_load(&_query_cache);
+            auto coll = _coll.collection();
+            return details::cached_find<T>(coll, cache.get(), filter.view(),
+                                           wrapper().projected(options));
+        };
+
+        // Recorded outside of the single flight, so that coalesced calls are counted too.
+        return recorded("find_cached", filter.view(), details::sort_of(options), [&] {
+            auto in_flight = std::atomic_load(&_in_flight);
+            if (!in_flight) {
+                return fetch();
+            }
+
+            return in_flight->find_cached.run(details::find_cache_key(filter.view(), options),
+                                              fetch);
+        });
+    }
+
+    /**
+     * Pages through the documents in this collection which match the provided filter, in the
+     * given sort order. Pages are fetched by range on the sort keys and _id rather than with
+     * skip(), so deep pages cost the same as the first one (see mangrove::paginator).
+     *
+     * @param filter
+     *   Document view representing the documents to page through.
+     * @param sort
+     *   A sort expression, e.g. MANGROVE_KEY(T::field).sort(true).
+     * @param page_size
+     *   The maximum number of objects in a page.
+     * @param options
+     *   Optional arguments, see mongocxx::options::find. The sort and limit are ignored.
+     * @param position
+     *   The position to resume from, see paginator::position().
+     *
+     * @return A paginator whose next_page() returns successive pages.
+     * @throws std::logic_error if page_size is not positive.
+     */
+    template <typename NvpT>
+    static paginator<T, sort_expr<NvpT>> paginate(
+        bsoncxx::document::view_or_value filter, const sort_expr<NvpT>& sort,
+        std::int64_t page_size,
+        const mongocxx::options::find& options = mongocxx::options::find(),
+        bsoncxx::stdx::optional<bsoncxx::document::value> position = bsoncxx::stdx::nullopt) {
+        return {std::move(filter), std::make_tuple(sort), page_size, options,
+                std::move(position)};
+    }
+
+    /**
+     * Pages through the documents in this collection which match the provided filter, in the
+     * order given by a list of sort expressions, e.g.
+     * (MANGROVE_KEY(T::a).sort(true), MANGROVE_KEY(T::b).sort(false)).
+     *
+     * @see paginate(bsoncxx::document::view_or_value, const sort_expr<NvpT>&, std::int64_t)
+     */
+    template <typename... Sorts>
+    static paginator<T, Sorts...> paginate(
+        bsoncxx::document::view_or_value filter,
+        const expression_list<expression_category::sort, Sorts...>& sort, std::int64_t page_size,
+        const mongocxx::options::find& options = mongocxx::options::find(),
+        bsoncxx::stdx::optional<bsoncxx::document::value> position = bsoncxx::stdx::nullopt) {
+        return {std::move(filter), sort.storage, page_size, options, std::move(position)};
+    }
+
+    /**
+     * Returns a name-value pair representing the _id field, for use in queries, sorts and
+     * projections built outside of the class, where the protected _id member cannot be named.
+     */
+    static constexpr nvp<model, IdType> id_key() {
+        return {&model::_id, "_id"};
+    }
+
+    /**
+     * Creates an expression that matches the objects whose ObjectId _id was generated between the
+     * given times, inclusive, with a precision of one second. This is answered with the _id index,
+     * and combined with a sort on id_key(), yields the objects in creation order.
+     *
+     * @see mangrove::created_between()
+     */
+    template <typename Duration, typename Id = IdType,
+              typename = std::enable_if_t<std::is_same<Id, bsoncxx::oid>::value>>
+    static range_expr<nvp<model, IdType>, bsoncxx::oid> created_between(
+        const std::chrono::time_point<std::chrono::system_clock, Duration>& from,
+        const std::chrono::time_point<std::chrono::system_clock, Duration>& to) {
+        return mangrove::created_between(id_key(), from, to);
+    }
+
+    /**
+     * Creates an expression that matches the objects whose ObjectId _id was generated at or after
+     * the given time, with a precision of one second.
+     */
+    template <typename Duration, typename Id = IdType,
+              typename = std::enable_if_t<std::is_same<Id, bsoncxx::oid>::value>>
+    static range_expr<nvp<model, IdType>, bsoncxx::oid> created_after(
+        const std::chrono::time_point<std::chrono::system_clock, Duration>& from) {
+        return mangrove::created_after(id_key(), from);
+    }
+
+    /**
+     * Creates an expression that matches the objects whose ObjectId _id was generated before the
+     * second containing the given time.
+     */
+    template <typename Duration, typename Id = IdType,
+              typename = std::enable_if_t<std::is_same<Id, bsoncxx::oid>::value>>
+    static range_expr<nvp<model, IdType>, bsoncxx::oid> created_before(
+        const std::chrono::time_point<std::chrono::system_clock, Duration>& to) {
+        return mangrove::created_before(id_key(), to);
     }
 
     /**
      * Finds a single document in this collection that matches the provided filter.
      *
+     * If the cache is enabled (see enable_cache()) and the filter is a plain lookup by _id without
+     * a projection, the object is served from the cache when possible. If request coalescing is
+     * enabled (see enable_request_coalescing()), concurrent identical lookups share one query.
+     *
      * @param filter
      *   Document view representing a document that should match the query.
      * @param options
@@ -170,7 +926,162 @@ class model {
     static mongocxx::stdx::optional<T> find_one(
         bsoncxx::document::view_or_value filter,
         const mongocxx::options::find& options = mongocxx::options::find()) {
-        return _coll.find_one(std::move(filter), options);
+        return recorded("find_one", filter.view(), details::sort_of(options),
+                        [&] { return lookup_one(filter.view(), options); });
+    }
+
+    /**
+     * Finds the documents in this collection which match the provided filter, and yields the
+     * value of a single field from each of them, without deserializing whole objects.
+     *
+     * @param field
+     *   A name-value pair representing the field, e.g. MANGROVE_KEY(T::field).
+     * @param filter
+     *   Document view representing a document that should match the query.
+     * @param options
+     *   Optional arguments, see mongocxx::options::find
+     *
+     * @return Cursor yielding the values of the field.
+     * @throws
+     *   If the find failed, the returned cursor will throw mongocxx::exception::query when it
+     *   is iterated.
+     */
+    template <typename NvpT, typename = std::enable_if_t<is_nvp_v<NvpT>>>
+    static value_cursor<typename NvpT::type> find_values(
+        const NvpT& field,
+        bsoncxx::document::view_or_value filter = bsoncxx::document::view_or_value{},
+        const mongocxx::options::find& options = mongocxx::options::find()) {
+        if (auto recorder = std::atomic_load(&_query_recorder)) {
+            recorder->record("find_values", filter.view(), details::sort_of(options));
+        }
+        return _coll.find_values(field, std::move(filter), options);
+    }
+
+    /**
+     * Finds the distinct values of a field across the documents matching the provided filter.
+     *
+     * @param field
+     *   A name-value pair representing the field, e.g. MANGROVE_KEY(T::field).
+     * @param filter
+     *   Document view representing the documents to consider.
+     * @param options
+     *   Optional arguments, see mongocxx::options::distinct.
+     *
+     * @return A vector of the distinct values.
+     * @throws mongocxx::exception::query if the operation fails.
+     *
+     * @see https://docs.mongodb.com/manual/reference/command/distinct/
+     */
+    template <typename NvpT, typename = std::enable_if_t<is_nvp_v<NvpT>>>
+    static std::vector<typename NvpT::array_element_type> distinct(
+        const NvpT& field,
+        bsoncxx::document::view_or_value filter = bsoncxx::document::view_or_value{},
+        const mongocxx::options::distinct& options = mongocxx::options::distinct()) {
+        return recorded("distinct", filter.view(), {},
+                        [&] { return _coll.distinct(field, filter.view(), options); });
+    }
+
+    /**
+     * Finds the object with the given _id.
+     *
+     * If the cache is enabled (see enable_cache()), the object is served from the cache when
+     * possible.
+     *
+     * @param id
+     *   The _id of the object to find.
+     * @param options
+     *   Optional arguments, see mongocxx::options::find
+     *
+     * @return An optional object with the given _id.
+     * @throws mongocxx::exception::query if the operation fails.
+     */
+    static mongocxx::stdx::optional<T> find_by_id(
+        const IdType& id, const mongocxx::options::find& options = mongocxx::options::find()) {
+        return find_one(details::id_filter(id), options);
+    }
+
+    /**
+     * Finds the objects with the given _ids.
+     *
+     * The ids are looked up in the cache first, if it is enabled (see enable_cache()). The
+     * remaining ids are fetched with {_id: {$in: [...]}} queries of at most options.chunk_size ids
+     * each. If a pool was set with set_pool(), up to options.max_parallelism of these queries are
+     * run concurrently.
+     *
+     * @tparam Range
+     *   A range type whose elements are of type IdType.
+     * @param ids
+     *   The _ids of the objects to find. May contain duplicates.
+     * @param options
+     *   The chunk size and parallelism of the queries, see mangrove::batch_options.
+     *
+     * @return A vector holding, for each id in the order they were given, either the object with
+     *         that id, or an empty optional if no such object exists.
+     * @throws mongocxx::exception::query if any of the queries fails.
+     * @throws boson::Exception if a document cannot be deserialized. A document that exists but
+     *         doesn't decode is never reported as missing.
+     */
+    template <typename Range>
+    static std::vector<mongocxx::stdx::optional<T>> find_by_ids(
+        const Range& ids, const batch_options& options = batch_options()) {
+        // Every chunk has the shape {_id: {$in: ?}}, whatever its ids.
+        std::vector<IdType> no_ids;
+        auto shape = details::ids_in_filter(no_ids.begin(), no_ids.end());
+        return recorded("find_by_ids", shape.view(), {},
+                        [&] { return lookup_by_ids(ids, options); });
+    }
+
+    /**
+     * Calls a function on every object in this collection matching the provided filter, scanning
+     * several ranges of _id concurrently.
+     *
+     * The split points between the ranges are chosen from a random sample of the matching
+     * documents, so that the ranges hold about the same number of documents. Each range is then
+     * read and deserialized by its own thread, using its own client from the pool set with
+     * set_pool(). Without a pool, the ranges are scanned one after the other on the calling thread.
+     *
+     * Choosing the split points is cheap for an empty filter, but otherwise reads every matching
+     * document on the server. The ranges are bounded with $gte and $lt, which only match values
+     * of the same BSON type as the split points: documents whose _id is of another type than
+     * the split points, e.g. a string among ObjectIds, are skipped.
+     *
+     * @param filter
+     *   Document view representing the documents to scan.
+     * @param n_partitions
+     *   The number of ranges, and the maximum number of threads.
+     * @param callback
+     *   A function called with each deserialized object. It may be called concurrently from
+     *   several threads, in no particular order.
+     * @param options
+     *   Optional arguments for the queries of the ranges, see mongocxx::options::find.
+     *
+     * @throws mongocxx::exception::query if any of the queries fails.
+     * @throws boson::Exception if a document cannot be deserialized.
+     */
+    template <typename Callback>
+    static void parallel_scan(bsoncxx::document::view_or_value filter, std::size_t n_partitions,
+                              const Callback& callback,
+                              const mongocxx::options::find& options = mongocxx::options::find()) {
+        scan_partitions("_id", filter.view(), n_partitions, callback, options);
+    }
+
+    /**
+     * Calls a function on every object in this collection matching the provided filter, scanning
+     * several ranges of the given field concurrently. The field should be indexed, and be present
+     * with the same type in every matching document: documents in which it is missing, or of
+     * another type than the split points, are skipped.
+     *
+     * @param field
+     *   A name-value pair representing the field to split on, e.g. MANGROVE_KEY(T::field).
+     *
+     * @see parallel_scan(bsoncxx::document::view_or_value, std::size_t, const Callback&)
+     */
+    template <typename NvpT, typename Callback, typename = std::enable_if_t<is_nvp_v<NvpT>>>
+    static void parallel_scan(const NvpT& field, bsoncxx::document::view_or_value filter,
+                              std::size_t n_partitions, const Callback& callback,
+                              const mongocxx::options::find& options = mongocxx::options::find()) {
+        std::string key;
+        scan_partitions(field.append_name(key), filter.view(), n_partitions, callback, options);
     }
 
     /**
@@ -201,6 +1112,19 @@ class model {
         return insert_many(container.begin(), container.end(), options);
     }
 
+    /**
+     *  Inserts the objects of a container into the collection. If an id sequence is set (see
+     *  set_id_sequence()), the ids are assigned to the objects of the container, whereas the
+     *  overload taking a const container assigns them to copies.
+     */
+    template <typename container_type,
+              typename = std::enable_if_t<container_of_v<container_type, T>>>
+    static mongocxx::stdx::optional<mongocxx::result::insert_many> insert_many(
+        container_type& container,
+        const mongocxx::options::insert& options = mongocxx::options::insert()) {
+        return insert_many(container.begin(), container.end(), options);
+    }
+
     /**
      *  Inserts multiple objects of the model into the collection.
      *
@@ -208,6 +1132,10 @@ class model {
      *  the legacy OP_INSERT wire protocol message. As a result, using this method to insert
      *  many documents on MongoDB < 2.6 will be slow.
      *
+     *  If an id sequence is set (see set_id_sequence()), ids are assigned in place when the
+     *  iterators are mutable forward iterators. Otherwise they are assigned to copies of the
+     *  objects, and are only available as the inserted_ids() of the result.
+     *
      *  @tparam object_iterator_type
      *    The iterator type. Must meet the requirements for the input iterator concept with the
      *    model class as the value type.
@@ -230,14 +1158,25 @@ class model {
     static mongocxx::stdx::optional<mongocxx::result::insert_many> insert_many(
         object_iterator_type begin, object_iterator_type end,
         const mongocxx::options::insert& options = mongocxx::options::insert()) {
-        return _coll.insert_many(begin, end, options);
+        auto sequence = std::atomic_load(&_id_sequence);
+        if (!sequence) {
+            auto result = _coll.insert_many(begin, end, options);
+            bump_query_epoch();
+            return result;
+        }
+
+        auto result = insert_many_with_ids(begin, end, options, sequence,
+                                           is_mutable_forward_iterator<object_iterator_type>{});
+        bump_query_epoch();
+        return result;
     }
 
     /**
      *  Inserts a single object of the model into the collection.
      *
      *  @param obj
-     *    The object of the model to insert.
+     *    The object of the model to insert. If an id sequence is set (see set_id_sequence()) and
+     *    its _id is zero, the next id of the sequence is assigned to it.
      *  @param options
      *    Optional arguments, see mongocxx::options::insert.
      *
@@ -247,8 +1186,30 @@ class model {
      *  @throws mongocxx::exception::write if the operation fails.
      */
     static mongocxx::stdx::optional<mongocxx::result::insert_one> insert_one(
-        T obj, const mongocxx::options::insert& options = mongocxx::options::insert()) {
-        return _coll.insert_one(obj, options);
+        T& obj, const mongocxx::options::insert& options = mongocxx::options::insert()) {
+        assign_id(obj, std::atomic_load(&_id_sequence));
+        auto result = _coll.insert_one(obj, options);
+        bump_query_epoch();
+        return result;
+    }
+
+    /**
+     *  Inserts a copy of a single object of the model into the collection. If an id sequence is
+     *  set, the id assigned to the copy is only available as the inserted_id() of the result.
+     *
+     *  @see insert_one(T&, const mongocxx::options::insert&)
+     */
+    static mongocxx::stdx::optional<mongocxx::result::insert_one> insert_one(
+        const T& obj, const mongocxx::options::insert& options = mongocxx::options::insert()) {
+        auto sequence = std::atomic_load(&_id_sequence);
+        if (!sequence) {
+            auto result = _coll.insert_one(obj, options);
+            bump_query_epoch();
+            return result;
+        }
+
+        T copy{obj};
+        return insert_one(copy, options);
     }
 
     /**
@@ -270,7 +1231,11 @@ class model {
         auto id_match_filter = bsoncxx::builder::stream::document{}
                                << "_id" << this->_id << bsoncxx::builder::stream::finalize;
 
-        return _coll.collection().delete_one(id_match_filter.view(), options);
+        auto result = recorded("remove", id_match_filter.view(), {}, [&] {
+            return _coll.collection().delete_one(id_match_filter.view(), options);
+        });
+        invalidate_cached(id_match_filter.view());
+        return result;
     }
 
     /**
@@ -292,6 +1257,58 @@ class model {
         _coll = collection_wrapper<T>(std::move(coll));
     }
 
+    /**
+     * Enables or disables automatic projection, which is enabled by default. When enabled,
+     * reads only fetch the fields that the result type maps with MANGROVE_MAKE_KEYS or
+     * MANGROVE_MAKE_KEYS_MODEL. Reads that pass their own projection, and reads into types that
+     * inherit boson::UnderlyingBSONDataBase, are never changed. Unlike setCollection(), this
+     * applies to all threads.
+     *
+     * @param enabled Whether to apply the projection automatically.
+     */
+    static void set_auto_projection(bool enabled) {
+        _auto_projection.store(enabled, std::memory_order_relaxed);
+    }
+
+    /**
+     * Sets the client pool used by operations that run several queries concurrently, such as
+     * find_by_ids(). Unlike setCollection(), this applies to all threads.
+     *
+     * @param pool
+     *   The pool from which worker threads acquire their clients. Must outlive every operation
+     *   that uses it.
+     * @param db_name
+     *   The name of the database holding the collection mapped to this class.
+     * @param coll_name
+     *   The name of the collection mapped to this class.
+     */
+    static void set_pool(mongocxx::pool& pool, std::string db_name, std::string coll_name) {
+        std::atomic_store(&_pool, std::shared_ptr<const pool_binding>(new pool_binding{
+                                      &pool, std::move(db_name), std::move(coll_name)}));
+    }
+
+    /**
+     * Unbinds the client pool set with set_pool(), so that operations run their queries on the
+     * calling thread's collection again.
+     */
+    static void clear_pool() {
+        std::atomic_store(&_pool, std::shared_ptr<const pool_binding>{});
+    }
+
+    /**
+     * Sets the sequence from which integer _ids are assigned. Once set, insert_one(),
+     * insert_many() and save() assign the next id of the sequence to every object whose _id is
+     * zero, without an extra round-trip per object. Unlike setCollection(), this applies to all
+     * threads.
+     *
+     * @param sequence
+     *   The sequence to allocate ids from, or nullptr to let the application assign them.
+     */
+    template <typename Id = IdType, typename = std::enable_if_t<std::is_integral<Id>::value>>
+    static void set_id_sequence(std::shared_ptr<id_sequence> sequence) {
+        std::atomic_store(&_id_sequence, std::move(sequence));
+    }
+
     /**
      * Performs an update in the database that saves the current T object instance to the
      * collection mapped to this class.
@@ -313,6 +1330,8 @@ class model {
      */
     mongocxx::stdx::optional<mongocxx::result::update> save(
         mongocxx::options::update options = mongocxx::options::update()) {
+        assign_id(*static_cast<T*>(this), std::atomic_load(&_id_sequence));
+
         auto id_match_filter = bsoncxx::builder::stream::document{}
                                << "_id" << this->_id << bsoncxx::builder::stream::finalize;
 
@@ -322,7 +1341,11 @@ class model {
 
         options.upsert(true);
 
-        return _coll.collection().update_one(id_match_filter.view(), update.view(), options);
+        auto result = recorded("save", id_match_filter.view(), {}, [&] {
+            return _coll.collection().update_one(id_match_filter.view(), update.view(), options);
+        });
+        invalidate_cached(id_match_filter.view());
+        return result;
     }
 
     /**
@@ -343,7 +1366,11 @@ class model {
     static mongocxx::stdx::optional<mongocxx::result::update> update_many(
         bsoncxx::document::view_or_value filter, bsoncxx::document::view_or_value update,
         const mongocxx::options::update& options = mongocxx::options::update()) {
-        return _coll.collection().update_many(filter, update, options);
+        auto result = recorded("update_many", filter.view(), {}, [&] {
+            return _coll.collection().update_many(filter.view(), update, options);
+        });
+        invalidate_cached(filter.view());
+        return result;
     }
 
     /**
@@ -364,11 +1391,94 @@ class model {
     static mongocxx::stdx::optional<mongocxx::result::update> update_one(
         bsoncxx::document::view_or_value filter, bsoncxx::document::view_or_value update,
         const mongocxx::options::update& options = mongocxx::options::update()) {
-        return _coll.collection().update_many(filter, update, options);
+        auto result = recorded("update_one", filter.view(), {}, [&] {
+            return _coll.collection().update_many(filter.view(), update, options);
+        });
+        invalidate_cached(filter.view());
+        return result;
+    }
+
+#if MONGOCXX_VERSION_MAJOR > 3 || (MONGOCXX_VERSION_MAJOR == 3 && MONGOCXX_VERSION_MINOR >= 5)
+    /**
+     *  Updates multiple documents matching the provided filter with an update pipeline, which
+     *  computes new field values from the current ones on the server. Requires MongoDB 4.2.
+     *
+     *  @param filter
+     *    Document representing the match criteria.
+     *  @param update
+     *    The stages of the update, see mangrove::update_pipeline.
+     *  @param options
+     *    Optional arguments, see mongocxx::options::update.
+     *
+     *  @return The result of attempting to update multiple documents.
+     *  @throws mongocxx::exception::write if the update operation fails.
+     *
+     *  @see https://docs.mongodb.com/manual/tutorial/update-documents-with-aggregation-pipeline/
+     */
+    static mongocxx::stdx::optional<mongocxx::result::update> update_many(
+        bsoncxx::document::view_or_value filter, const update_pipeline& update,
+        const mongocxx::options::update& options = mongocxx::options::update()) {
+        auto result = recorded("update_many", filter.view(), {}, [&] {
+            return _coll.collection().update_many(filter.view(), update.pipeline(), options);
+        });
+        invalidate_cached(filter.view());
+        return result;
+    }
+
+    /**
+     *  Updates a single document matching the provided filter with an update pipeline.
+     *
+     *  @see update_many(bsoncxx::document::view_or_value, const update_pipeline&,
+     *                   const mongocxx::options::update&)
+     */
+    static mongocxx::stdx::optional<mongocxx::result::update> update_one(
+        bsoncxx::document::view_or_value filter, const update_pipeline& update,
+        const mongocxx::options::update& options = mongocxx::options::update()) {
+        auto result = recorded("update_one", filter.view(), {}, [&] {
+            return _coll.collection().update_one(filter.view(), update.pipeline(), options);
+        });
+        invalidate_cached(filter.view());
+        return result;
+    }
+#endif
+
+    /**
+     *  Finds a single document matching the provided filter, applies an update to it, and
+     *  returns either the original or the updated object. The read and the write are a single
+     *  atomic operation, which makes this suitable for claiming jobs, bumping counters or taking
+     *  leases, without a separate read or a whole-document replace.
+     *
+     *  @param filter
+     *    Document representing the match criteria.
+     *  @param update
+     *    Document representing the update to be applied to the matching document.
+     *  @param options
+     *    Optional arguments, see mongocxx::options::find_one_and_update.
+     *
+     *  @return The original or updated object, or an empty optional if no document matched.
+     *  @throws mongocxx::exception::write if the operation fails.
+     *
+     *  @see https://docs.mongodb.com/manual/reference/command/findAndModify/
+     */
+    static mongocxx::stdx::optional<T> find_one_and_update(
+        bsoncxx::document::view_or_value filter, bsoncxx::document::view_or_value update,
+        const mongocxx::options::find_one_and_update& options =
+            mongocxx::options::find_one_and_update()) {
+        auto result =
+            recorded("find_one_and_update", filter.view(), details::sort_of(options),
+                     [&] { return _coll.find_one_and_update(filter.view(), update, options); });
+
+        // Only the returned object was modified, so only it needs to leave the cache.
+        if (result) {
+            invalidate_cached_id(details::id_key(details::id_filter(result->_id).view()));
+        } else {
+            invalidate_cached(filter.view());
+        }
+        return result;
     }
 
    protected:
-    IdType _id;
+    IdType _id{};
 };
 
 #ifdef __APPLE__
@@ -379,5 +1489,29 @@ template <typename T, typename IdType>
 thread_local collection_wrapper<T> model<T, IdType>::_coll;
 #endif
 
+template <typename T, typename IdType>
+std::shared_ptr<lru_cache<T>> model<T, IdType>::_cache;
+
+template <typename T, typename IdType>
+std::shared_ptr<query_cache<T>> model<T, IdType>::_query_cache;
+
+template <typename T, typename IdType>
+std::shared_ptr<typename model<T, IdType>::in_flight_calls> model<T, IdType>::_in_flight;
+
+template <typename T, typename IdType>
+std::shared_ptr<const typename model<T, IdType>::pool_binding> model<T, IdType>::_pool;
+
+template <typename T, typename IdType>
+std::shared_ptr<field_access_tracker> model<T, IdType>::_field_access;
+
+template <typename T, typename IdType>
+std::shared_ptr<query_recorder> model<T, IdType>::_query_recorder;
+
+template <typename T, typename IdType>
+std::atomic<bool> model<T, IdType>::_auto_projection{true};
+
+template <typename T, typename IdType>
+std::shared_ptr<id_sequence> model<T, IdType>::_id_sequence;
+
 MANGROVE_INLINE_NAMESPACE_END
 }  // namespace mangrove
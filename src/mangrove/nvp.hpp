@@ -18,9 +18,13 @@
 
 #include <cstddef>
 #include <stdexcept>
+#include <string>
 #include <tuple>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
+#include <bsoncxx/stdx/optional.hpp>
 #include <bsoncxx/types.hpp>
 
 #include <mangrove/expression_syntax.hpp>
@@ -33,6 +37,11 @@ MANGROVE_INLINE_NAMESPACE_BEGIN
 template <typename NvpT, typename T>
 class nvp_base;
 
+// GeoJSON types, defined in mangrove/geo.hpp.
+class geo_point;
+class geo_polygon;
+struct geo_center_sphere;
+
 struct current_date_t {
     constexpr current_date_t() {
     }
@@ -284,6 +293,53 @@ class dollar_operator_nvp : public nvp_base<dollar_operator_nvp<NvpT>, typename
     const NvpT& _nvp;
 };
 
+/**
+ * Represents the $[] and $[<identifier>] operators applied to an array field. In an update, these
+ * modify every element of the array, or only the elements matching the array filter with the
+ * given identifier (see mangrove::array_filter()).
+ */
+template <typename NvpT>
+class filtered_positional_nvp
+    : public nvp_base<filtered_positional_nvp<NvpT>, typename NvpT::type> {
+   public:
+    using type = iterable_value_t<typename NvpT::no_opt_type>;
+    // In case this field is wrapped in an optional, store the underlying type.
+    using no_opt_type = remove_optional_t<type>;
+
+    /**
+     * @param nvp         The name-value pair of the array field.
+     * @param identifier  The identifier of an array filter, or an empty string for $[].
+     */
+    constexpr filtered_positional_nvp(const NvpT& nvp, const char* identifier)
+        : _nvp(nvp), _identifier(identifier) {
+    }
+
+    /**
+     * Creates an update expression that sets the matching elements to the given value.
+     */
+    constexpr update_expr<filtered_positional_nvp<NvpT>, no_opt_type> operator=(
+        const no_opt_type& val) const {
+        return {*this, val, "$set"};
+    }
+
+    std::string get_name() const {
+        std::string s;
+        return append_name(s);
+    }
+
+    /**
+     * Returns the name of this field with the operator, i.e. "field.$[identifier]" or "field.$[]".
+     * @return A string containing the name of this field in dot notation.
+     */
+    std::string& append_name(std::string& s) const {
+        return _nvp.append_name(s).append(".$[").append(_identifier).append(1, ']');
+    }
+
+   private:
+    const NvpT& _nvp;
+    const char* _identifier;
+};
+
 /**
  * A CRTP base class that contains member functions for name-value pairs.
  * These functions are identical between nvp<...> and nvp_child<...>, but their return types are
@@ -614,6 +670,72 @@ class nvp_base {
                 "$bitsAnyClear"};
     }
 
+    /* Geospatial queries, which require mangrove/geo.hpp. */
+
+    /**
+     * Creates a query with the $near operator, which returns documents from the nearest to the
+     * farthest from a point on a sphere. This requires a 2dsphere index on the field.
+     * @param point         The point to measure distances from.
+     * @param max_distance  The maximum distance in meters, if any.
+     * @param min_distance  The minimum distance in meters, if any.
+     * @returns A geo_expr representing this query.
+     */
+    template <typename U = no_opt_type>
+    geo_expr<NvpT> near(const geo_point& point,
+                        bsoncxx::stdx::optional<double> max_distance = {},
+                        bsoncxx::stdx::optional<double> min_distance = {}) const {
+        return {*static_cast<const NvpT*>(this), "$near", point, max_distance, min_distance};
+    }
+
+    /**
+     * Creates a query with the $nearSphere operator, which behaves like $near on GeoJSON points
+     * but also computes spherical distances on 2d indexes.
+     * @see near()
+     */
+    template <typename U = no_opt_type>
+    geo_expr<NvpT> near_sphere(const geo_point& point,
+                               bsoncxx::stdx::optional<double> max_distance = {},
+                               bsoncxx::stdx::optional<double> min_distance = {}) const {
+        return {*static_cast<const NvpT*>(this), "$nearSphere", point, max_distance, min_distance};
+    }
+
+    /**
+     * Creates a query with the $geoWithin operator, which matches geometries that lie entirely
+     * within a polygon.
+     */
+    template <typename U = no_opt_type>
+    geo_expr<NvpT> geo_within(const geo_polygon& polygon) const {
+        return {*static_cast<const NvpT*>(this), "$geoWithin", polygon};
+    }
+
+    /**
+     * Creates a query with the $geoWithin operator, which matches the geometries within a circle
+     * on a sphere, using $centerSphere. This is how radius queries are written without sorting
+     * the results by distance.
+     */
+    template <typename U = no_opt_type>
+    geo_expr<NvpT> geo_within(const geo_center_sphere& circle) const {
+        return {*static_cast<const NvpT*>(this), "$geoWithin", circle};
+    }
+
+    /**
+     * Creates a query with the $geoIntersects operator, which matches geometries that intersect
+     * a point.
+     */
+    template <typename U = no_opt_type>
+    geo_expr<NvpT> geo_intersects(const geo_point& point) const {
+        return {*static_cast<const NvpT*>(this), "$geoIntersects", point};
+    }
+
+    /**
+     * Creates a query with the $geoIntersects operator, which matches geometries that intersect
+     * a polygon.
+     */
+    template <typename U = no_opt_type>
+    geo_expr<NvpT> geo_intersects(const geo_polygon& polygon) const {
+        return {*static_cast<const NvpT*>(this), "$geoIntersects", polygon};
+    }
+
     constexpr update_expr<NvpT, no_opt_type> set_on_insert(const no_opt_type& val) const {
         return {*static_cast<const NvpT*>(this), val, "$setOnInsert"};
     }
@@ -661,6 +783,30 @@ class nvp_base {
         return {*static_cast<const NvpT*>(this)};
     }
 
+    /**
+     * Returns a name-value pair with the $[] operator appended to it.
+     * When used in an update expression, this modifies every element of the array.
+     * @returns a filtered_positional_nvp that corresponds to "<field_name>.$[]"
+     */
+    template <typename U = no_opt_type, typename = std::enable_if_t<is_iterable_v<U>>>
+    constexpr filtered_positional_nvp<NvpT> all_elements() const {
+        return {*static_cast<const NvpT*>(this), ""};
+    }
+
+    /**
+     * Returns a name-value pair with the $[<identifier>] operator appended to it.
+     * When used in an update expression, this modifies the array elements that match the array
+     * filter with the same identifier, which is passed in the array_filters option of the update.
+     * @param identifier  The identifier, which must start with a lowercase letter and contain only
+     *                    alphanumeric characters.
+     * @returns a filtered_positional_nvp that corresponds to "<field_name>.$[<identifier>]"
+     * @see mangrove::array_filter()
+     */
+    template <typename U = no_opt_type, typename = std::enable_if_t<is_iterable_v<U>>>
+    constexpr filtered_positional_nvp<NvpT> filtered(const char* identifier) const {
+        return {*static_cast<const NvpT*>(this), identifier};
+    }
+
     /**
      * Creates an update expression with the $pop operator.
      * This is only enabled if the current field is an array type.
@@ -789,6 +935,9 @@ struct is_nvp<free_nvp<T>> : public std::true_type {};
 template <typename NvpT>
 struct is_nvp<array_element_nvp<NvpT>> : public std::true_type {};
 
+template <typename NvpT>
+struct is_nvp<filtered_positional_nvp<NvpT>> : public std::true_type {};
+
 template <typename T>
 constexpr bool is_nvp_v = is_nvp<T>::value;
 
@@ -808,6 +957,85 @@ nvp_child<Base, T, Parent> constexpr make_nvp_with_parent(const nvp<Base, T>& ch
     return nvp_child<Base, T, Parent>(child.t, child.name, parent);
 }
 
+namespace details {
+
+// The characters used in compact keys. A compact key never starts with a digit.
+constexpr char compact_key_chars[] =
+    "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+
+/**
+ * The compact key of the I-th mapped field: a single letter for the first 52 fields, and a letter
+ * followed by a letter or digit for the others.
+ */
+template <std::size_t I, bool = (I < 52)>
+struct compact_key {
+    static constexpr char value[2] = {compact_key_chars[I], '\0'};
+};
+
+template <std::size_t I>
+struct compact_key<I, false> {
+    static_assert(I < 52 + 52 * 62, "Too many fields for compact keys");
+    static constexpr char value[3] = {compact_key_chars[(I - 52) / 62],
+                                      compact_key_chars[(I - 52) % 62], '\0'};
+};
+
+template <std::size_t I, bool B>
+constexpr char compact_key<I, B>::value[2];
+
+template <std::size_t I>
+constexpr char compact_key<I, false>::value[3];
+
+constexpr bool is_id_name(const char* name) {
+    return name[0] == '_' && name[1] == 'i' && name[2] == 'd' && name[3] == '\0';
+}
+
+// Renames the I-th field to its compact key. _id is never renamed.
+template <std::size_t I, typename Base, typename T>
+constexpr nvp<Base, T> compact_nvp(const nvp<Base, T>& field) {
+    return is_id_name(field.name) ? field : nvp<Base, T>(field.t, compact_key<I>::value);
+}
+
+template <typename... Fields, std::size_t... I>
+constexpr auto compact_fields(const std::tuple<Fields...>& fields, std::index_sequence<I...>) {
+    return std::make_tuple(compact_nvp<I>(std::get<I>(fields))...);
+}
+
+}  // namespace details
+
+/**
+ * Renames each of the given fields to a short key that is assigned by its position, i.e. "a" for
+ * the first field, "b" for the second, and so on. A field named _id keeps its name. This is used by
+ * MANGROVE_MAKE_KEYS_COMPACT.
+ *
+ * @param fields A tuple of name-value pairs, as passed to MANGROVE_MAKE_KEYS.
+ * @return The tuple of renamed name-value pairs.
+ */
+template <typename... Fields>
+constexpr auto compact_fields(const std::tuple<Fields...>& fields) {
+    return details::compact_fields(fields, std::index_sequence_for<Fields...>{});
+}
+
+/**
+ * Returns the alias table of a class registered with MANGROVE_MAKE_KEYS_COMPACT, which maps the
+ * name of each field to the key it is stored under. This is useful when inspecting documents
+ * without going through mangrove, e.g. in the mongo shell.
+ *
+ * @tparam T A class registered with MANGROVE_MAKE_KEYS_COMPACT.
+ * @return A vector of (field name, stored key) pairs, in the order the fields were registered.
+ */
+template <typename T>
+std::vector<std::pair<std::string, std::string>> field_aliases() {
+    std::vector<std::pair<std::string, std::string>> aliases;
+    tuple_for_each(T::mangrove_field_names(),
+                   [&](const auto& field) { aliases.emplace_back(field.name, std::string{}); });
+
+    std::size_t i = 0;
+    tuple_for_each(T::mangrove_mapped_fields(),
+                   [&](const auto& field) { aliases[i++].second = field.name; });
+
+    return aliases;
+}
+
 /**
  * hasField determines whether a type Base has a member of the given type T as
  * the Nth member out of M total members which have name value pairs.
@@ -0,0 +1,124 @@
+// Copyright 2016 MongoDB Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <mangrove/config/prelude.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <type_traits>
+
+#include <bsoncxx/oid.hpp>
+#include <bsoncxx/stdx/optional.hpp>
+
+#include <mangrove/nvp.hpp>
+#include <mangrove/query_builder.hpp>
+
+namespace mangrove {
+MANGROVE_INLINE_NAMESPACE_BEGIN
+
+namespace details {
+
+/**
+ * Builds an ObjectId whose timestamp is the given time, truncated to seconds and clamped to the
+ * range of ObjectId timestamps, and whose remaining eight bytes all have the given value.
+ */
+template <typename Duration>
+bsoncxx::oid oid_for(const std::chrono::time_point<std::chrono::system_clock, Duration>& tp,
+                     char fill) {
+    auto seconds = std::chrono::duration_cast<std::chrono::seconds>(tp.time_since_epoch()).count();
+    if (seconds < 0) {
+        seconds = 0;
+    } else if (seconds > 0xffffffffLL) {
+        seconds = 0xffffffffLL;
+    }
+
+    // The timestamp is stored big-endian in the first four bytes.
+    auto timestamp = static_cast<std::uint32_t>(seconds);
+    char bytes[12];
+    bytes[0] = static_cast<char>((timestamp >> 24) & 0xff);
+    bytes[1] = static_cast<char>((timestamp >> 16) & 0xff);
+    bytes[2] = static_cast<char>((timestamp >> 8) & 0xff);
+    bytes[3] = static_cast<char>(timestamp & 0xff);
+    for (int i = 4; i < 12; ++i) {
+        bytes[i] = fill;
+    }
+    return bsoncxx::oid{bytes, sizeof(bytes)};
+}
+
+template <typename NvpT>
+using enable_if_oid_nvp_t =
+    std::enable_if_t<is_nvp_v<NvpT> &&
+                     std::is_same<typename NvpT::no_opt_type, bsoncxx::oid>::value>;
+
+}  // namespace details
+
+/**
+ * Returns the smallest ObjectId that can be generated during the second containing the given time.
+ */
+template <typename Duration>
+bsoncxx::oid min_oid_for(const std::chrono::time_point<std::chrono::system_clock, Duration>& tp) {
+    return details::oid_for(tp, '\x00');
+}
+
+/**
+ * Returns the largest ObjectId that can be generated during the second containing the given time.
+ */
+template <typename Duration>
+bsoncxx::oid max_oid_for(const std::chrono::time_point<std::chrono::system_clock, Duration>& tp) {
+    return details::oid_for(tp, '\xff');
+}
+
+/**
+ * Creates an expression that matches documents whose ObjectId field was generated between the
+ * given times, inclusive, with a precision of one second. Since ObjectIds start with their
+ * creation time, this selects the documents created in that window using the index on the field,
+ * without a separate date field. Sorting on the same field then orders them by creation time.
+ *
+ * @param field  A name-value pair of type bsoncxx::oid, usually the _id of a model.
+ * @param from   The earliest creation time.
+ * @param to     The latest creation time.
+ */
+template <typename NvpT, typename Duration, typename = details::enable_if_oid_nvp_t<NvpT>>
+range_expr<NvpT, bsoncxx::oid> created_between(
+    const NvpT& field, const std::chrono::time_point<std::chrono::system_clock, Duration>& from,
+    const std::chrono::time_point<std::chrono::system_clock, Duration>& to) {
+    return {field, min_oid_for(from), "$gte", max_oid_for(to), "$lte"};
+}
+
+/**
+ * Creates an expression that matches documents whose ObjectId field was generated at or after the
+ * given time, with a precision of one second.
+ */
+template <typename NvpT, typename Duration, typename = details::enable_if_oid_nvp_t<NvpT>>
+range_expr<NvpT, bsoncxx::oid> created_after(
+    const NvpT& field, const std::chrono::time_point<std::chrono::system_clock, Duration>& from) {
+    return {field, min_oid_for(from), "$gte", bsoncxx::stdx::nullopt, "$lte"};
+}
+
+/**
+ * Creates an expression that matches documents whose ObjectId field was generated before the
+ * second containing the given time.
+ */
+template <typename NvpT, typename Duration, typename = details::enable_if_oid_nvp_t<NvpT>>
+range_expr<NvpT, bsoncxx::oid> created_before(
+    const NvpT& field, const std::chrono::time_point<std::chrono::system_clock, Duration>& to) {
+    return {field, bsoncxx::stdx::nullopt, "$gte", min_oid_for(to), "$lt"};
+}
+
+MANGROVE_INLINE_NAMESPACE_END
+}  // namespace mangrove
+
+#include <mangrove/config/postlude.hpp>
@@ -0,0 +1,266 @@
+// Copyright 2016 MongoDB Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <mangrove/config/prelude.hpp>
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <bsoncxx/builder/core.hpp>
+#include <bsoncxx/document/value.hpp>
+#include <bsoncxx/document/view.hpp>
+#include <bsoncxx/document/view_or_value.hpp>
+#include <bsoncxx/stdx/optional.hpp>
+#include <bsoncxx/types.hpp>
+#include <bsoncxx/types/value.hpp>
+#include <mongocxx/options/find.hpp>
+
+#include <boson/mapping_functions.hpp>
+#include <mangrove/query_builder.hpp>
+#include <mangrove/util.hpp>
+#include <mangrove/value_cursor.hpp>
+
+namespace mangrove {
+MANGROVE_INLINE_NAMESPACE_BEGIN
+
+namespace details {
+
+/**
+ * Appends the value of the field at the given dotted path in a document to a BSON core builder,
+ * under the path itself as the key. Missing fields are appended as null.
+ */
+inline void append_field_at_path(bsoncxx::builder::core& builder, bsoncxx::document::view doc,
+                                 const std::string& path) {
+    builder.key_owned(path);
+
+    auto parent = find_parent(doc, path);
+    if (parent) {
+        auto dot = path.rfind('.');
+        auto name = dot == std::string::npos ? path : path.substr(dot + 1);
+        auto it = parent->find(name);
+        if (it != parent->end()) {
+            builder.append(it->get_value());
+            return;
+        }
+    }
+    builder.append(bsoncxx::types::b_null{});
+}
+
+}  // namespace details
+
+/**
+ * Pages through the documents matching a query in a fixed sort order, using keyset (range-based)
+ * pagination instead of skip().
+ *
+ * After each page, the paginator remembers the values of the sort keys of the last document it
+ * returned, together with its _id, which breaks ties between documents with equal sort keys. The
+ * next page is then fetched with a filter that only matches documents after that position, e.g.
+ * for a sort on {age: 1}:
+ *
+ *     {$and: [<filter>, {$or: [{age: {$gt: 30}}, {age: {$eq: 30}, _id: {$gt: <id>}}]}]}
+ *
+ * Unlike skip(), which walks every skipped document, this costs the same for every page if there
+ * is an index on the sort keys followed by _id.
+ *
+ * The sort keys should be present, with the same type, in every matching document. Documents that
+ * are inserted or modified behind the current position are not returned.
+ *
+ * @tparam T      The model class whose documents are paged through.
+ * @tparam Sorts  The types of the sort expressions, see nvp::sort().
+ */
+template <typename T, typename... Sorts>
+class paginator {
+   public:
+    /**
+     * Creates a paginator.
+     *
+     * @param filter
+     *   Document view representing the documents to page through.
+     * @param sorts
+     *   The sort expressions that define the order of the pages.
+     * @param page_size
+     *   The maximum number of objects in a page.
+     * @param options
+     *   Optional arguments, see mongocxx::options::find. The sort and limit options are
+     *   overridden by the paginator.
+     * @param position
+     *   The position to resume from, as returned by position() for an earlier paginator with the
+     *   same filter and sort order. If empty, paging starts at the first document.
+     *
+     * @throws std::logic_error if page_size is not positive.
+     */
+    paginator(bsoncxx::document::view_or_value filter, std::tuple<Sorts...> sorts,
+              std::int64_t page_size,
+              const mongocxx::options::find& options = mongocxx::options::find(),
+              bsoncxx::stdx::optional<bsoncxx::document::value> position = bsoncxx::stdx::nullopt)
+        : _filter(filter.view()),
+          _sorts(std::move(sorts)),
+          _page_size(page_size),
+          _options(options),
+          _position(std::move(position)) {
+        if (_page_size <= 0) {
+            throw std::logic_error("The page size must be positive.");
+        }
+
+        tuple_for_each(_sorts, [&](const auto& sort) {
+            std::string name;
+            if (sort.field().append_name(name) == "_id") {
+                _sorts_by_id = true;
+            }
+        });
+    }
+
+    /**
+     * Fetches the next page of objects. Once the last page has been returned, this returns an
+     * empty vector.
+     *
+     * @throws mongocxx::exception::query if the query fails.
+     */
+    std::vector<T> next_page() {
+        if (!_has_more) {
+            return {};
+        }
+
+        auto options = _options;
+        options.sort(sort_document());
+        // Fetch one more object than needed to find out whether there is another page.
+        options.limit(_page_size + 1);
+
+        auto filter = page_filter();
+        auto page = T::find_page(filter.view(), options);
+        _has_more = static_cast<std::int64_t>(page.size()) > _page_size;
+        if (_has_more) {
+            page.pop_back();
+        }
+
+        if (!page.empty()) {
+            _position = position_of(page.back());
+        }
+        return page;
+    }
+
+    /**
+     * Returns false once next_page() has returned the last page.
+     */
+    bool has_more() const {
+        return _has_more;
+    }
+
+    /**
+     * Returns the values of the sort keys and the _id of the last object returned, or an empty
+     * optional if no page has been fetched yet. This can be handed to a client as an opaque token,
+     * and passed to a new paginator to resume paging after that object.
+     */
+    const bsoncxx::stdx::optional<bsoncxx::document::value>& position() const {
+        return _position;
+    }
+
+   private:
+    // Builds the sort document {key1: +/-1, ..., _id: 1}.
+    bsoncxx::document::value sort_document() const {
+        auto builder = bsoncxx::builder::core(false);
+        tuple_for_each(_sorts, [&](const auto& sort) { sort.append_to_bson(builder); });
+        if (!_sorts_by_id) {
+            builder.key_view("_id");
+            builder.append(1);
+        }
+        return builder.extract_document();
+    }
+
+    // Builds the filter for the documents after the current position.
+    bsoncxx::document::value page_filter() const {
+        if (!_position) {
+            return _filter;
+        }
+
+        auto position = _position->view();
+        auto builder = bsoncxx::builder::core(false);
+        builder.key_view("$and");
+        builder.open_array();
+        builder.append(bsoncxx::types::b_document{_filter.view()});
+        builder.open_document();
+        builder.key_view("$or");
+        builder.open_array();
+
+        // The i-th clause matches the documents whose first i keys are equal to the current
+        // position, and whose (i + 1)-th key comes after it.
+        const std::size_t clauses = sizeof...(Sorts) + (_sorts_by_id ? 0 : 1);
+        for (std::size_t i = 0; i < clauses; ++i) {
+            builder.open_document();
+
+            std::size_t j = 0;
+            tuple_for_each(_sorts, [&](const auto& sort) {
+                if (j <= i) {
+                    using field_type = std::decay_t<decltype(sort.field())>;
+                    std::string name;
+                    auto value = position[sort.field().append_name(name)].get_value();
+                    const char* op = j < i ? "$eq" : sort.ascending() ? "$gt" : "$lt";
+                    comparison_value_expr<field_type, bsoncxx::types::value>{sort.field(), value,
+                                                                             op}
+                        .append_to_bson(builder);
+                }
+                ++j;
+            });
+
+            if (j == i) {
+                builder.key_view("_id");
+                builder.open_document();
+                builder.key_view("$gt");
+                builder.append(position["_id"].get_value());
+                builder.close_document();
+            }
+
+            builder.close_document();
+        }
+
+        builder.close_array();
+        builder.close_document();
+        builder.close_array();
+        return builder.extract_document();
+    }
+
+    // Extracts the position of the given object, i.e. the values of its sort keys and its _id.
+    bsoncxx::document::value position_of(const T& obj) const {
+        auto doc = boson::to_document(obj);
+        auto builder = bsoncxx::builder::core(false);
+        tuple_for_each(_sorts, [&](const auto& sort) {
+            std::string name;
+            details::append_field_at_path(builder, doc.view(), sort.field().append_name(name));
+        });
+        if (!_sorts_by_id) {
+            details::append_field_at_path(builder, doc.view(), "_id");
+        }
+        return builder.extract_document();
+    }
+
+    const bsoncxx::document::value _filter;
+    const std::tuple<Sorts...> _sorts;
+    const std::int64_t _page_size;
+    const mongocxx::options::find _options;
+    bsoncxx::stdx::optional<bsoncxx::document::value> _position;
+    bool _has_more = true;
+    bool _sorts_by_id = false;
+};
+
+MANGROVE_INLINE_NAMESPACE_END
+}  // namespace mangrove
+
+#include <mangrove/config/postlude.hpp>
@@ -0,0 +1,135 @@
+// Copyright 2016 MongoDB Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <mangrove/config/prelude.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+
+#include <bsoncxx/array/value.hpp>
+#include <bsoncxx/array/view.hpp>
+#include <bsoncxx/builder/core.hpp>
+#include <bsoncxx/document/value.hpp>
+#include <bsoncxx/document/view.hpp>
+#include <bsoncxx/types.hpp>
+#include <mongocxx/collection.hpp>
+#include <mongocxx/pipeline.hpp>
+
+namespace mangrove {
+MANGROVE_INLINE_NAMESPACE_BEGIN
+
+namespace details {
+
+// The number of documents sampled for each partition when choosing split points.
+constexpr std::int32_t samples_per_partition = 64;
+
+/**
+ * Chooses the values of a key that split the documents matching a filter into ranges of about
+ * equal size. The split points are computed by the server from a random sample of the documents,
+ * with $sample followed by $bucketAuto, so that they are ordered by the BSON comparison order.
+ *
+ * With an empty filter, $sample is the first stage, which the server answers with a random cursor
+ * without reading the whole collection. Otherwise $sample has to follow a $match stage, so the
+ * server reads every matching document to draw the sample; on large collections, prefer scanning
+ * with an empty filter and discarding unwanted objects in the callback.
+ *
+ * @param coll The collection to split.
+ * @param filter The filter that the documents must match.
+ * @param key The dotted name of the key to split on.
+ * @param n_partitions The number of ranges wanted.
+ * @return The sorted split points, of which there are at most n_partitions - 1. This may be empty
+ *         if there are too few documents, or too few distinct values of the key.
+ */
+inline bsoncxx::array::value partition_split_points(mongocxx::collection& coll,
+                                                    bsoncxx::document::view filter,
+                                                    const std::string& key,
+                                                    std::size_t n_partitions) {
+    auto builder = bsoncxx::builder::core(true);
+    if (n_partitions < 2) {
+        return builder.extract_array();
+    }
+
+    auto bucket_auto = bsoncxx::builder::core(false);
+    bucket_auto.key_view("groupBy");
+    bucket_auto.append("$" + key);
+    bucket_auto.key_view("buckets");
+    bucket_auto.append(static_cast<std::int32_t>(n_partitions));
+
+    mongocxx::pipeline pipeline;
+    if (!filter.empty()) {
+        pipeline.match(filter);
+    }
+    pipeline.sample(static_cast<std::int32_t>(n_partitions) * samples_per_partition);
+    pipeline.bucket_auto(bucket_auto.view_document());
+
+    // Every bucket but the first starts at a split point.
+    bool first = true;
+    for (auto&& bucket : coll.aggregate(pipeline)) {
+        if (!first) {
+            builder.append(bucket["_id"]["min"].get_value());
+        }
+        first = false;
+    }
+    return builder.extract_array();
+}
+
+/**
+ * Builds the filter that matches the documents matching the given filter whose key is in the
+ * i-th of the ranges delimited by the given split points. The first range is unbounded below,
+ * and the last one is unbounded above.
+ *
+ * Since $gte and $lt only compare values of the same BSON type, documents whose key is missing,
+ * or of another type than the split points, fall in none of the ranges.
+ */
+inline bsoncxx::document::value partition_filter(bsoncxx::document::view filter,
+                                                 const std::string& key,
+                                                 bsoncxx::array::view split_points,
+                                                 std::size_t i) {
+    auto n_points =
+        static_cast<std::size_t>(std::distance(split_points.begin(), split_points.end()));
+    if (n_points == 0) {
+        return bsoncxx::document::value{filter};
+    }
+
+    auto builder = bsoncxx::builder::core(false);
+    builder.key_view("$and");
+    builder.open_array();
+    builder.append(bsoncxx::types::b_document{filter});
+    builder.open_document();
+    builder.key_owned(key);
+    builder.open_document();
+    if (i > 0) {
+        builder.key_view("$gte");
+        builder.append(split_points[static_cast<std::uint32_t>(i - 1)].get_value());
+    }
+    if (i < n_points) {
+        builder.key_view("$lt");
+        builder.append(split_points[static_cast<std::uint32_t>(i)].get_value());
+    }
+    builder.close_document();
+    builder.close_document();
+    builder.close_array();
+    return builder.extract_document();
+}
+
+}  // namespace details
+
+MANGROVE_INLINE_NAMESPACE_END
+}  // namespace mangrove
+
+#include <mangrove/config/postlude.hpp>
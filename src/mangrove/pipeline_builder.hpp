@@ -0,0 +1,358 @@
+// Copyright 2016 MongoDB Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <mangrove/config/prelude.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include <bsoncxx/builder/core.hpp>
+#include <bsoncxx/document/view_or_value.hpp>
+#include <bsoncxx/types.hpp>
+#include <mongocxx/pipeline.hpp>
+
+#include <mangrove/nvp.hpp>
+#include <mangrove/query_builder.hpp>
+#include <mangrove/util.hpp>
+
+namespace mangrove {
+MANGROVE_INLINE_NAMESPACE_BEGIN
+
+namespace details {
+
+// Returns the field path expression "$name" of a name-value pair.
+template <typename NvpT>
+std::string field_path(const NvpT& field) {
+    std::string path = "$";
+    return field.append_name(path);
+}
+
+}  // namespace details
+
+/**
+ * Represents an accumulator of a $group stage, with the syntax "output: {$op: input}", where
+ * output is a field of the result type and input is a field of the grouped documents.
+ * @tparam NvpT The type of the name-value pair of the output field.
+ */
+template <typename NvpT>
+class accumulator_expr {
+   public:
+    /**
+     * Constructs an accumulator over the values of an input field.
+     * @param  output   The name-value pair of the output field.
+     * @param  op       The accumulator operator, such as $sum.
+     * @param  input    The field path of the input field, such as "$amount".
+     */
+    accumulator_expr(const NvpT& output, const char* op, std::string input)
+        : _output(output), _operator(op), _input(std::move(input)) {
+    }
+
+    /**
+     * Appends this accumulator to a BSON core builder, as a key-value pair of the form
+     * "output: {$op: input}". If there is no input field, the operand is the constant 1.
+     * @param builder   A BSON core builder
+     */
+    void append_to_bson(bsoncxx::builder::core& builder) const {
+        std::string s;
+        builder.key_owned(_output.append_name(s));
+        builder.open_document();
+        builder.key_view(_operator);
+        if (_input.empty()) {
+            builder.append(std::int32_t{1});
+        } else {
+            builder.append(_input);
+        }
+        builder.close_document();
+    }
+
+   private:
+    const NvpT _output;
+    const char* _operator;
+    const std::string _input;
+};
+
+/**
+ * Functions that create the accumulators of a $group stage, e.g.
+ * sum(MANGROVE_KEY(Report::total), MANGROVE_KEY(Order::amount)).
+ */
+namespace accumulators {
+
+#define MANGROVE_DEFINE_ACCUMULATOR(name, op)                                               \
+    template <typename OutNvpT, typename InNvpT,                                            \
+              typename = std::enable_if_t<is_nvp_v<OutNvpT> && is_nvp_v<InNvpT>>>           \
+    accumulator_expr<OutNvpT> name(const OutNvpT& output, const InNvpT& input) {            \
+        return {output, op, details::field_path(input)};                                    \
+    }
+
+MANGROVE_DEFINE_ACCUMULATOR(sum, "$sum")
+MANGROVE_DEFINE_ACCUMULATOR(avg, "$avg")
+MANGROVE_DEFINE_ACCUMULATOR(min, "$min")
+MANGROVE_DEFINE_ACCUMULATOR(max, "$max")
+MANGROVE_DEFINE_ACCUMULATOR(first, "$first")
+MANGROVE_DEFINE_ACCUMULATOR(last, "$last")
+MANGROVE_DEFINE_ACCUMULATOR(push, "$push")
+MANGROVE_DEFINE_ACCUMULATOR(add_to_set, "$addToSet")
+
+#undef MANGROVE_DEFINE_ACCUMULATOR
+
+/**
+ * Creates an accumulator that counts the documents of each group.
+ */
+template <typename OutNvpT, typename = std::enable_if_t<is_nvp_v<OutNvpT>>>
+accumulator_expr<OutNvpT> count(const OutNvpT& output) {
+    return {output, "$sum", std::string{}};
+}
+
+}  // namespace accumulators
+
+/**
+ * Builds an aggregation pipeline from name-value pairs and query builder expressions, instead of
+ * hand-written BSON with string field names. The result converts to a mongocxx::pipeline, which
+ * can be passed to model::aggregate() or collection_wrapper::aggregate() to decode its output into
+ * a Result type.
+ *
+ * Example:
+ *
+ *     using namespace mangrove::accumulators;
+ *     pipeline_builder stages;
+ *     stages.match(MANGROVE_KEY(Order::status) == "paid")
+ *         .group(MANGROVE_KEY(Order::customer),
+ *                sum(MANGROVE_KEY(Report::total), MANGROVE_KEY(Order::amount)),
+ *                count(MANGROVE_KEY(Report::orders)))
+ *         .sort(MANGROVE_KEY(Report::total).sort(false))
+ *         .limit(10);
+ *     for (Report r : Order::aggregate<Report>(stages)) { ... }
+ *
+ * Fields of the documents entering a stage are named with the name-value pairs of the type they
+ * are mapped to, and fields created by a stage with those of the type they are decoded into.
+ */
+class pipeline_builder {
+   public:
+    /**
+     * Appends a $match stage. The filter may be a query builder expression.
+     */
+    pipeline_builder& match(bsoncxx::document::view_or_value filter) {
+        _pipeline.match(std::move(filter));
+        return *this;
+    }
+
+    /**
+     * Appends a $sort stage. The order may be a sort expression or a list of them, e.g.
+     * (MANGROVE_KEY(T::a).sort(true), MANGROVE_KEY(T::b).sort(false)).
+     */
+    pipeline_builder& sort(bsoncxx::document::view_or_value order) {
+        _pipeline.sort(std::move(order));
+        return *this;
+    }
+
+    /**
+     * Appends a $limit stage.
+     */
+    pipeline_builder& limit(std::int32_t n) {
+        _pipeline.limit(n);
+        return *this;
+    }
+
+    /**
+     * Appends a $skip stage.
+     */
+    pipeline_builder& skip(std::int32_t n) {
+        _pipeline.skip(n);
+        return *this;
+    }
+
+    /**
+     * Appends a $project stage that keeps only the given fields, and _id.
+     */
+    template <typename... NvpTs,
+              typename = std::enable_if_t<all_true<is_nvp_v<NvpTs>...>::value>>
+    pipeline_builder& project(const NvpTs&... fields) {
+        auto builder = bsoncxx::builder::core(false);
+        tuple_for_each(std::forward_as_tuple(fields...), [&](const auto& field) {
+            std::string s;
+            builder.key_owned(field.append_name(s));
+            builder.append(std::int32_t{1});
+        });
+        _pipeline.project(builder.view_document());
+        return *this;
+    }
+
+    /**
+     * Appends a $project stage with the given specification.
+     */
+    pipeline_builder& project(bsoncxx::document::view_or_value projection) {
+        _pipeline.project(std::move(projection));
+        return *this;
+    }
+
+    /**
+     * Appends an $unwind stage, which outputs one document per element of an array field.
+     */
+    template <typename NvpT, typename = std::enable_if_t<is_nvp_v<NvpT>>>
+    pipeline_builder& unwind(const NvpT& field) {
+        _pipeline.unwind(details::field_path(field));
+        return *this;
+    }
+
+    /**
+     * Appends a $group stage that groups documents by the value of a field, which becomes the _id
+     * of the output documents.
+     *
+     * @param key           The field to group by.
+     * @param accumulators  The accumulators computing the other fields of the output documents,
+     *                      see mangrove::accumulators.
+     */
+    template <typename NvpT, typename... Accumulators,
+              typename = std::enable_if_t<is_nvp_v<NvpT>>>
+    pipeline_builder& group(const NvpT& key, const Accumulators&... accumulators) {
+        auto builder = bsoncxx::builder::core(false);
+        builder.key_view("_id");
+        builder.append(details::field_path(key));
+        append_accumulators(builder, accumulators...);
+        _pipeline.group(builder.view_document());
+        return *this;
+    }
+
+    /**
+     * Appends a $group stage that combines all documents into one, whose _id is null.
+     */
+    template <typename... Accumulators>
+    pipeline_builder& group(std::nullptr_t, const Accumulators&... accumulators) {
+        auto builder = bsoncxx::builder::core(false);
+        builder.key_view("_id");
+        builder.append(bsoncxx::types::b_null{});
+        append_accumulators(builder, accumulators...);
+        _pipeline.group(builder.view_document());
+        return *this;
+    }
+
+    /**
+     * Appends a $lookup stage, which adds to each document the array of documents from another
+     * collection whose foreign field equals its local field.
+     *
+     * @param from     The name of the other collection.
+     * @param local    The field of the documents entering the stage.
+     * @param foreign  The field of the documents of the other collection.
+     * @param as       The array field of the output documents.
+     */
+    template <typename LocalNvpT, typename ForeignNvpT, typename AsNvpT,
+              typename = std::enable_if_t<is_nvp_v<LocalNvpT> && is_nvp_v<ForeignNvpT> &&
+                                          is_nvp_v<AsNvpT>>>
+    pipeline_builder& lookup(const std::string& from, const LocalNvpT& local,
+                             const ForeignNvpT& foreign, const AsNvpT& as) {
+        std::string local_name, foreign_name, as_name;
+        auto builder = bsoncxx::builder::core(false);
+        builder.key_view("from");
+        builder.append(from);
+        builder.key_view("localField");
+        builder.append(local.append_name(local_name));
+        builder.key_view("foreignField");
+        builder.append(foreign.append_name(foreign_name));
+        builder.key_view("as");
+        builder.append(as.append_name(as_name));
+        _pipeline.lookup(builder.view_document());
+        return *this;
+    }
+
+    /**
+     * A named sub-pipeline of a $facet stage.
+     */
+    using facet_spec = std::pair<std::string, std::reference_wrapper<const pipeline_builder>>;
+
+    /**
+     * Appends a $facet stage, which runs several sub-pipelines on the same input documents, and
+     * outputs a single document holding the results of each under the given name, e.g.
+     * facet({{"by_status", by_status}, {"by_day", by_day}}).
+     */
+    pipeline_builder& facet(std::initializer_list<facet_spec> facets) {
+        auto builder = bsoncxx::builder::core(false);
+        for (const auto& f : facets) {
+            builder.key_owned(f.first);
+            builder.append(bsoncxx::types::b_array{f.second.get()._pipeline.view_array()});
+        }
+        _pipeline.facet(builder.view_document());
+        return *this;
+    }
+
+    /**
+     * Appends an $out stage, which replaces the contents of the given collection with the output.
+     */
+    pipeline_builder& out(const std::string& collection) {
+        _pipeline.out(collection);
+        return *this;
+    }
+
+    /**
+     * Appends a $merge stage, which merges the output into the given collection, replacing the
+     * documents with the same _id and inserting the others. Requires MongoDB 4.2.
+     */
+    pipeline_builder& merge(const std::string& collection) {
+        auto builder = bsoncxx::builder::core(false);
+        builder.key_view("$merge");
+        builder.open_document();
+        builder.key_view("into");
+        builder.append(collection);
+        builder.key_view("whenMatched");
+        builder.append("replace");
+        builder.key_view("whenNotMatched");
+        builder.append("insert");
+        builder.close_document();
+        _pipeline.append_stage(builder.view_document());
+        return *this;
+    }
+
+    /**
+     * Appends a stage given as raw BSON, for stages not covered by this class.
+     */
+    pipeline_builder& append_stage(bsoncxx::document::view_or_value stage) {
+        _pipeline.append_stage(std::move(stage));
+        return *this;
+    }
+
+    /**
+     * Returns the pipeline built so far.
+     */
+    const mongocxx::pipeline& pipeline() const {
+        return _pipeline;
+    }
+
+    operator const mongocxx::pipeline&() const {
+        return _pipeline;
+    }
+
+   private:
+    static void append_accumulators(bsoncxx::builder::core&) {
+    }
+
+    template <typename Accumulator, typename... Accumulators>
+    static void append_accumulators(bsoncxx::builder::core& builder, const Accumulator& first,
+                                    const Accumulators&... rest) {
+        first.append_to_bson(builder);
+        append_accumulators(builder, rest...);
+    }
+
+    mongocxx::pipeline _pipeline;
+};
+
+MANGROVE_INLINE_NAMESPACE_END
+}  // namespace mangrove
+
+#include <mangrove/config/postlude.hpp>
@@ -0,0 +1,111 @@
+// Copyright 2016 MongoDB Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <mangrove/config/prelude.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include <bsoncxx/builder/core.hpp>
+#include <bsoncxx/document/value.hpp>
+#include <bsoncxx/stdx/optional.hpp>
+
+#include <boson/bson_archiver.hpp>
+#include <mangrove/util.hpp>
+
+namespace mangrove {
+MANGROVE_INLINE_NAMESPACE_BEGIN
+
+namespace details {
+
+/**
+ * Type trait that checks whether a type registered its fields with MANGROVE_MAKE_KEYS or
+ * MANGROVE_MAKE_KEYS_MODEL.
+ */
+template <typename T, typename = void>
+struct has_mapped_fields : public std::false_type {};
+
+template <typename T>
+struct has_mapped_fields<T, decltype(void(T::mangrove_mapped_fields()))>
+    : public std::true_type {};
+
+template <typename T>
+constexpr bool has_mapped_fields_v = has_mapped_fields<T>::value;
+
+/**
+ * Whether reads into a type can be projected onto its mapped fields. Types that inherit
+ * boson::UnderlyingBSONDataBase keep the raw document they were read from, including its unmapped
+ * fields, so they are always read in full.
+ */
+template <typename T>
+constexpr bool is_projectable_v =
+    has_mapped_fields_v<T> && !std::is_base_of<boson::UnderlyingBSONDataBase, T>::value;
+
+template <typename T>
+bsoncxx::document::value make_projection() {
+    auto builder = bsoncxx::builder::core(false);
+    bool has_id = false;
+
+    tuple_for_each(T::mangrove_mapped_fields(), [&](const auto& nvp) {
+        if (std::strcmp(nvp.name, "_id") == 0) {
+            has_id = true;
+        }
+        builder.key_view(nvp.name);
+        builder.append(std::int32_t{1});
+    });
+
+    // _id is returned unless explicitly excluded, so exclude it for types that don't map it.
+    if (!has_id) {
+        builder.key_view("_id");
+        builder.append(std::int32_t{0});
+    }
+
+    return builder.extract_document();
+}
+
+}  // namespace details
+
+/**
+ * Returns the projection that selects exactly the fields that a type maps, i.e. the fields passed
+ * to MANGROVE_MAKE_KEYS or MANGROVE_MAKE_KEYS_MODEL. Reading documents with this projection
+ * transfers only the bytes that deserializing into the type actually uses.
+ *
+ * @tparam T The type that documents are deserialized into.
+ * @return The projection document, or an empty optional if T does not register its fields or
+ *         inherits boson::UnderlyingBSONDataBase.
+ */
+template <typename T>
+std::enable_if_t<details::is_projectable_v<T>,
+                 const bsoncxx::stdx::optional<bsoncxx::document::value>&>
+projection_for() {
+    static const bsoncxx::stdx::optional<bsoncxx::document::value> projection{
+        details::make_projection<T>()};
+    return projection;
+}
+
+template <typename T>
+std::enable_if_t<!details::is_projectable_v<T>,
+                 const bsoncxx::stdx::optional<bsoncxx::document::value>&>
+projection_for() {
+    static const bsoncxx::stdx::optional<bsoncxx::document::value> projection;
+    return projection;
+}
+
+MANGROVE_INLINE_NAMESPACE_END
+}  // namespace mangrove
+
+#include <mangrove/config/postlude.hpp>
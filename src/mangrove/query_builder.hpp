@@ -19,10 +19,13 @@
 #include <chrono>
 #include <cstddef>
 #include <stdexcept>
+#include <string>
 #include <tuple>
 #include <type_traits>
+#include <utility>
 
 #include <bsoncxx/builder/core.hpp>
+#include <bsoncxx/stdx/optional.hpp>
 #include <bsoncxx/view_or_value.hpp>
 
 #include <mangrove/expression_syntax.hpp>
@@ -145,6 +148,20 @@ class sort_expr {
         return builder.extract_document();
     }
 
+    /**
+     * Returns the name-value pair that this expression sorts by.
+     */
+    constexpr const NvpT &field() const {
+        return _nvp;
+    }
+
+    /**
+     * Returns true if this expression sorts in ascending order.
+     */
+    constexpr bool ascending() const {
+        return _ascending;
+    }
+
    private:
     const NvpT _nvp;
     const bool _ascending;
@@ -256,6 +273,94 @@ class comparison_value_expr : public comparison_expr<NvpT, U> {
     const U _value;
 };
 
+/**
+ * Represents a query expression that matches a range of values of a field, with the syntax
+ * "key: {$gte: lower, $lt: upper}". Either bound may be omitted. Unlike comparison_expr, the bounds
+ * are stored by value, so they may be computed.
+ * @tparam NvpT The type of the name-value pair this expression uses.
+ * @tparam U    The type of the bounds.
+ */
+template <typename NvpT, typename U>
+class range_expr {
+   public:
+    using field_type = NvpT;
+    /**
+     * Constructs a range expression.
+     * @param  nvp           A name-value pair corresponding to a key in a document
+     * @param  lower         The lower bound, if any.
+     * @param  lower_op      The operator of the lower bound, $gt or $gte.
+     * @param  upper         The upper bound, if any.
+     * @param  upper_op      The operator of the upper bound, $lt or $lte.
+     */
+    constexpr range_expr(const NvpT &nvp, bsoncxx::stdx::optional<U> lower, const char *lower_op,
+                         bsoncxx::stdx::optional<U> upper, const char *upper_op)
+        : _nvp(nvp),
+          _lower(std::move(lower)),
+          _lower_operator(lower_op),
+          _upper(std::move(upper)),
+          _upper_operator(upper_op) {
+    }
+
+    /**
+     * Appends the name of the contained field to a string.
+     */
+    std::string &append_name(std::string &s) const {
+        return _nvp.append_name(s);
+    }
+
+    /**
+     * Appends this expression to a BSON core builder, as a key-value pair of the form
+     * "key: {$gte: lower, $lt: upper}".
+     * @param builder   A BSON core builder
+     * @param wrap      Whether to wrap the BSON inside a document.
+     * @param omit_name Whether to skip the name of the field, and only append the bounds.
+     */
+    void append_to_bson(bsoncxx::builder::core &builder, bool wrap = false,
+                        bool omit_name = false) const {
+        if (wrap) {
+            builder.open_document();
+        }
+        if (!omit_name) {
+            std::string s;
+            builder.key_view(_nvp.append_name(s));
+            builder.open_document();
+        }
+
+        if (_lower) {
+            builder.key_view(_lower_operator);
+            append_value_to_bson(*_lower, builder);
+        }
+        if (_upper) {
+            builder.key_view(_upper_operator);
+            append_value_to_bson(*_upper, builder);
+        }
+
+        if (!omit_name) {
+            builder.close_document();
+        }
+        if (wrap) {
+            builder.close_document();
+        }
+    }
+
+    /**
+     * Converts the expression to a BSON filter for a query.
+     * The format of the BSON is "{key: {$gte: lower, $lt: upper}}".
+     */
+    operator bsoncxx::document::view_or_value() const {
+        auto builder = bsoncxx::builder::core(false);
+        append_to_bson(builder);
+        return builder.extract_document();
+    }
+
+   private:
+    const NvpT _nvp;
+    const bsoncxx::stdx::optional<U> _lower;
+    const char *_lower_operator;
+    const bsoncxx::stdx::optional<U> _upper;
+    const char *_upper_operator;
+};
+
 /**
  * Represents a query that performs a text search with the $text operator.
  * TODO check values of `language` against spec?
@@ -0,0 +1,216 @@
+// Copyright 2016 MongoDB Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <mangrove/config/prelude.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <bsoncxx/builder/basic/document.hpp>
+#include <bsoncxx/builder/basic/kvp.hpp>
+#include <bsoncxx/types.hpp>
+#include <mongocxx/collection.hpp>
+#include <mongocxx/cursor.hpp>
+#include <mongocxx/options/find.hpp>
+
+#include <boson/mapping_functions.hpp>
+#include <mangrove/lru_cache.hpp>
+
+namespace mangrove {
+MANGROVE_INLINE_NAMESPACE_BEGIN
+
+/**
+ * A cache of decoded find() results, keyed by the BSON of the query that produced them.
+ *
+ * Every entry is tagged with the write epoch that was current when its query was sent. Writers
+ * call bump_epoch() after modifying the collection, which makes every entry fetched before the
+ * write stale without having to determine which queries the write could have affected.
+ *
+ * @tparam T The type that the cached documents are decoded into.
+ */
+template <typename T>
+class query_cache {
+   public:
+    using result_type = std::shared_ptr<const std::vector<T>>;
+
+    explicit query_cache(const cache_options& options = cache_options()) : _cache(options) {
+    }
+
+    query_cache(const query_cache&) = delete;
+    query_cache& operator=(const query_cache&) = delete;
+
+    /**
+     * Returns the cached results for a key if they are still current, and otherwise calls fetch
+     * to produce them and caches its result.
+     *
+     * @param key
+     *   The cache key of the query, see details::find_cache_key().
+     * @param fetch
+     *   A callable with the signature std::vector<T>(std::size_t& bytes), that runs the query and
+     *   stores the size of the raw results in bytes.
+     *
+     * @return The decoded results of the query.
+     */
+    template <typename Fetch>
+    result_type get_or_fetch(const std::string& key, Fetch&& fetch) {
+        auto epoch = _epoch.load(std::memory_order_acquire);
+
+        auto cached = _cache.get(key);
+        if (cached && cached->epoch == epoch) {
+            _hits.fetch_add(1, std::memory_order_relaxed);
+            return cached->results;
+        }
+
+        _misses.fetch_add(1, std::memory_order_relaxed);
+
+        std::size_t bytes = 0;
+        auto results = std::make_shared<const std::vector<T>>(fetch(bytes));
+        _cache.put(key, entry{results, epoch}, bytes);
+        return results;
+    }
+
+    /**
+     * Marks every entry cached so far as stale. Must be called after every write to the
+     * collection whose queries are cached.
+     */
+    void bump_epoch() {
+        _epoch.fetch_add(1, std::memory_order_acq_rel);
+    }
+
+    /**
+     * Removes every entry from the cache.
+     */
+    void clear() {
+        _cache.clear();
+    }
+
+    /**
+     * Returns the counters and current size of the cache. Lookups that found a stale entry are
+     * counted as misses.
+     */
+    cache_statistics stats() const {
+        auto result = _cache.stats();
+        result.hits = _hits.load(std::memory_order_relaxed);
+        result.misses = _misses.load(std::memory_order_relaxed);
+        return result;
+    }
+
+   private:
+    struct entry {
+        result_type results;
+        std::uint64_t epoch;
+    };
+
+    lru_cache<entry> _cache;
+    std::atomic<std::uint64_t> _epoch{0};
+    std::atomic<std::uint64_t> _hits{0};
+    std::atomic<std::uint64_t> _misses{0};
+};
+
+namespace details {
+
+/**
+ * Computes the key under which the results of a find() are cached. The key is the BSON of the
+ * filter together with every option that affects which documents are returned, or what they
+ * contain. Since the query builder always renders an expression the same way, identical queries
+ * map to identical keys.
+ */
+inline std::string find_cache_key(bsoncxx::document::view filter,
+                                  const mongocxx::options::find& options) {
+    using bsoncxx::builder::basic::kvp;
+    using bsoncxx::types::b_document;
+
+    bsoncxx::builder::basic::document key;
+    key.append(kvp("filter", b_document{filter}));
+
+    if (options.projection()) {
+        key.append(kvp("projection", b_document{options.projection()->view()}));
+    }
+    if (options.sort()) {
+        key.append(kvp("sort", b_document{options.sort()->view()}));
+    }
+    if (options.skip()) {
+        key.append(kvp("skip", *options.skip()));
+    }
+    if (options.limit()) {
+        key.append(kvp("limit", *options.limit()));
+    }
+    if (options.collation()) {
+        key.append(kvp("collation", b_document{options.collation()->view()}));
+    }
+    if (options.min()) {
+        key.append(kvp("min", b_document{options.min()->view()}));
+    }
+    if (options.max()) {
+        key.append(kvp("max", b_document{options.max()->view()}));
+    }
+
+    auto doc = key.extract();
+    return std::string(reinterpret_cast<const char*>(doc.view().data()), doc.view().length());
+}
+
+/**
+ * Decodes every document of a cursor into a vector, skipping documents that cannot be
+ * deserialized in the same way that deserializing_cursor does.
+ *
+ * @param c The cursor to exhaust.
+ * @param bytes Incremented by the size of every document read from the cursor.
+ */
+template <typename T>
+std::vector<T> decode_all(mongocxx::cursor&& c, std::size_t& bytes) {
+    std::vector<T> results;
+    for (auto&& doc : c) {
+        bytes += doc.length();
+        try {
+            results.push_back(boson::to_obj<T>(doc));
+        } catch (boson::Exception& e) {
+        }
+    }
+    return results;
+}
+
+/**
+ * Runs a find() against the given collection through a query cache. If cache is null, the query
+ * is always sent to the database.
+ */
+template <typename T>
+typename query_cache<T>::result_type cached_find(mongocxx::collection& coll,
+                                                 query_cache<T>* cache,
+                                                 bsoncxx::document::view filter,
+                                                 const mongocxx::options::find& options) {
+    auto fetch = [&](std::size_t& bytes) {
+        return decode_all<T>(coll.find(filter, options), bytes);
+    };
+
+    if (!cache) {
+        std::size_t bytes = 0;
+        return std::make_shared<const std::vector<T>>(fetch(bytes));
+    }
+
+    return cache->get_or_fetch(find_cache_key(filter, options), fetch);
+}
+
+}  // namespace details
+
+MANGROVE_INLINE_NAMESPACE_END
+}  // namespace mangrove
+
+#include <mangrove/config/postlude.hpp>
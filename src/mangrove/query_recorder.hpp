@@ -0,0 +1,450 @@
+// Copyright 2016 MongoDB Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <mangrove/config/prelude.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <bsoncxx/builder/core.hpp>
+#include <bsoncxx/document/element.hpp>
+#include <bsoncxx/document/value.hpp>
+#include <bsoncxx/document/view.hpp>
+#include <bsoncxx/stdx/optional.hpp>
+#include <bsoncxx/types.hpp>
+
+#include <mangrove/index.hpp>
+#include <mangrove/query_shape.hpp>
+
+namespace mangrove {
+MANGROVE_INLINE_NAMESPACE_BEGIN
+
+/**
+ * The statistics of the queries of one operation and shape, see mangrove::query_shape().
+ */
+struct recorded_query {
+    /**
+     * The operation, e.g. "find", "count", "update_many" or "delete_one".
+     */
+    std::string operation;
+
+    /**
+     * The shape of the filter and sort order of the queries.
+     */
+    std::string shape;
+
+    /**
+     * The number of queries of this shape.
+     */
+    std::uint64_t count = 0;
+
+    /**
+     * The number of queries whose latency was measured, and their total and highest latency.
+     * find() is counted but not timed, since its cursor only runs the query when iterated.
+     */
+    std::uint64_t timed_count = 0;
+    std::chrono::microseconds total_latency{0};
+    std::chrono::microseconds max_latency{0};
+
+    /**
+     * The fields that the filter compares for equality (including $in), compares against a
+     * range or with another operator, and queries with a geospatial operator. The fields of the
+     * clauses of $and and $or are included.
+     */
+    std::vector<std::string> equality_fields;
+    std::vector<std::string> range_fields;
+    std::vector<std::string> geo_fields;
+
+    /**
+     * The fields of the sort order, with their direction, 1 or -1.
+     */
+    std::vector<std::pair<std::string, std::int32_t>> sort_fields;
+
+    /**
+     * Whether the filter performs a $text search.
+     */
+    bool text_search = false;
+};
+
+namespace details {
+
+inline void add_field(std::vector<std::string>& fields, std::string name) {
+    if (std::find(fields.begin(), fields.end(), name) == fields.end()) {
+        fields.push_back(std::move(name));
+    }
+}
+
+inline bool is_geo_operator(const std::string& op) {
+    return op == "$near" || op == "$nearSphere" || op == "$geoWithin" || op == "$geoIntersects";
+}
+
+// Collects the fields that a filter queries, by kind of predicate.
+inline void collect_query_fields(bsoncxx::document::view filter, recorded_query& query) {
+    for (auto&& elem : filter) {
+        std::string key(elem.key().data(), elem.key().size());
+
+        if (!key.empty() && key[0] == '$') {
+            if (key == "$text") {
+                query.text_search = true;
+            } else if ((key == "$and" || key == "$or") &&
+                       elem.type() == bsoncxx::type::k_array) {
+                for (auto&& clause : elem.get_array().value) {
+                    if (clause.type() == bsoncxx::type::k_document) {
+                        collect_query_fields(clause.get_document().value, query);
+                    }
+                }
+            }
+            continue;
+        }
+
+        if (elem.type() != bsoncxx::type::k_document ||
+            !is_operator_document(elem.get_document().value)) {
+            add_field(query.equality_fields, std::move(key));
+            continue;
+        }
+
+        bool equality = false;
+        bool geo = false;
+        for (auto&& op_elem : elem.get_document().value) {
+            std::string op(op_elem.key().data(), op_elem.key().size());
+            equality = equality || op == "$eq" || op == "$in" || op == "$all" ||
+                       op == "$elemMatch";
+            geo = geo || is_geo_operator(op);
+        }
+        add_field(equality ? query.equality_fields
+                           : geo ? query.geo_fields : query.range_fields,
+                  std::move(key));
+    }
+}
+
+// Returns the direction of a key of a sort order or of an index, or an empty optional if it is
+// not a direction, e.g. {$meta: "textScore"} or "2dsphere".
+inline bsoncxx::stdx::optional<std::int32_t> key_direction(
+    const bsoncxx::document::element& elem) {
+    switch (elem.type()) {
+        case bsoncxx::type::k_int32:
+            return elem.get_int32().value < 0 ? -1 : 1;
+        case bsoncxx::type::k_int64:
+            return elem.get_int64().value < 0 ? -1 : 1;
+        case bsoncxx::type::k_double:
+            return elem.get_double().value < 0 ? -1 : 1;
+        default:
+            return {};
+    }
+}
+
+inline void collect_sort_fields(bsoncxx::document::view sort, recorded_query& query) {
+    for (auto&& elem : sort) {
+        if (auto direction = key_direction(elem)) {
+            query.sort_fields.emplace_back(std::string(elem.key().data(), elem.key().size()),
+                                           *direction);
+        }
+    }
+}
+
+}  // namespace details
+
+/**
+ * Records the shapes of the queries run against a collection, with how often each shape runs and
+ * how long it takes, in order to find the queries that lack a supporting index. See
+ * mangrove::advise_indexes().
+ *
+ * Recording is opt-in: attach a recorder with model::enable_query_recording(), or with
+ * collection_wrapper::record_queries(). Recording adds a lock and the computation of the shape
+ * to every query, so it is meant for profiling and staging environments.
+ */
+class query_recorder {
+   public:
+    query_recorder() = default;
+
+    query_recorder(const query_recorder&) = delete;
+    query_recorder& operator=(const query_recorder&) = delete;
+
+    /**
+     * Records a query.
+     *
+     * @param operation The operation, e.g. "find" or "update_many".
+     * @param filter    The filter of the query.
+     * @param sort      The sort order of the query, or an empty document.
+     * @param latency   How long the query took, if it was measured.
+     */
+    void record(const std::string& operation, bsoncxx::document::view filter,
+                bsoncxx::document::view sort = bsoncxx::document::view{},
+                bsoncxx::stdx::optional<std::chrono::microseconds> latency = {}) {
+        auto shape = query_shape(filter, sort);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto& query = _queries[operation + " " + shape];
+        if (query.count == 0) {
+            query.operation = operation;
+            query.shape = std::move(shape);
+            details::collect_query_fields(filter, query);
+            details::collect_sort_fields(sort, query);
+        }
+
+        ++query.count;
+        if (latency) {
+            ++query.timed_count;
+            query.total_latency += *latency;
+            query.max_latency = std::max(query.max_latency, *latency);
+        }
+    }
+
+    /**
+     * Returns the statistics of every operation and shape recorded so far, the most frequent
+     * first.
+     */
+    std::vector<recorded_query> queries() const {
+        std::vector<recorded_query> result;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (const auto& kv : _queries) {
+                result.push_back(kv.second);
+            }
+        }
+        std::stable_sort(result.begin(), result.end(),
+                         [](const recorded_query& a, const recorded_query& b) {
+                             return a.count > b.count;
+                         });
+        return result;
+    }
+
+   private:
+    mutable std::mutex _mutex;
+    std::map<std::string, recorded_query> _queries;
+};
+
+namespace details {
+
+// Runs op(), and records it with its latency if a recorder is given.
+template <typename Op>
+auto record_query(query_recorder* recorder, const char* operation,
+                  bsoncxx::document::view filter, bsoncxx::document::view sort, const Op& op)
+    -> decltype(op()) {
+    if (!recorder) {
+        return op();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto result = op();
+    recorder->record(operation, filter, sort,
+                     std::chrono::duration_cast<std::chrono::microseconds>(
+                         std::chrono::steady_clock::now() - start));
+    return result;
+}
+
+template <typename Options>
+bsoncxx::document::view sort_of(const Options& options) {
+    return options.sort() ? options.sort()->view() : bsoncxx::document::view{};
+}
+
+inline bool contains(const std::vector<std::string>& fields, const std::string& name) {
+    return std::find(fields.begin(), fields.end(), name) != fields.end();
+}
+
+// Returns true if an index can serve a query: it is a text index for a $text search, its first
+// key is one of the fields that the query filters on, or, for queries without a filter, its keys
+// start with the sort order, in the same or in the reverse direction.
+inline bool supports_query(const index_spec& index, const recorded_query& query) {
+    auto keys = index.keys();
+    if (query.text_search) {
+        for (auto&& elem : keys) {
+            if (elem.type() == bsoncxx::type::k_utf8 &&
+                elem.get_utf8().value.compare("text") == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    auto first = keys.begin();
+    if (first == keys.end()) {
+        return false;
+    }
+
+    std::string first_key(first->key().data(), first->key().size());
+    if (contains(query.equality_fields, first_key) || contains(query.range_fields, first_key) ||
+        contains(query.geo_fields, first_key)) {
+        return true;
+    }
+
+    if (!query.equality_fields.empty() || !query.range_fields.empty() ||
+        !query.geo_fields.empty() || query.sort_fields.empty()) {
+        return false;
+    }
+
+    bool same = true;
+    bool reversed = true;
+    auto key = keys.begin();
+    for (const auto& wanted : query.sort_fields) {
+        if (key == keys.end() ||
+            std::string(key->key().data(), key->key().size()) != wanted.first) {
+            return false;
+        }
+        auto direction = key_direction(*key);
+        if (!direction) {
+            return false;
+        }
+        same = same && *direction == wanted.second;
+        reversed = reversed && *direction == -wanted.second;
+        ++key;
+    }
+    return same || reversed;
+}
+
+// Returns true if a query filters or sorts on any field, and so could use an index.
+inline bool is_selective(const recorded_query& query) {
+    return query.text_search || !query.equality_fields.empty() || !query.range_fields.empty() ||
+           !query.geo_fields.empty() || !query.sort_fields.empty();
+}
+
+// Suggests an index for a query: equality fields first, then the sort order, then range fields,
+// and geospatial fields last, in a 2dsphere key.
+inline bsoncxx::document::value suggest_index_keys(const recorded_query& query) {
+    std::vector<std::string> added;
+    auto builder = bsoncxx::builder::core(false);
+    auto append = [&](const std::string& field, const auto& value) {
+        if (!contains(added, field)) {
+            added.push_back(field);
+            builder.key_owned(field);
+            builder.append(value);
+        }
+    };
+
+    for (const auto& field : query.equality_fields) {
+        append(field, std::int32_t{1});
+    }
+    for (const auto& field : query.sort_fields) {
+        append(field.first, field.second);
+    }
+    for (const auto& field : query.range_fields) {
+        append(field, std::int32_t{1});
+    }
+    for (const auto& field : query.geo_fields) {
+        append(field, "2dsphere");
+    }
+    return builder.extract_document();
+}
+
+}  // namespace details
+
+/**
+ * An index that would serve recorded queries that no existing index supports.
+ */
+struct index_suggestion {
+    /**
+     * The keys of the suggested index.
+     */
+    bsoncxx::document::value keys;
+
+    /**
+     * The operations and shapes of the queries that it would serve, e.g. "find {"age": ?}".
+     */
+    std::vector<std::string> shapes;
+
+    /**
+     * The number of recorded queries that it would serve.
+     */
+    std::uint64_t queries = 0;
+};
+
+/**
+ * The result of mangrove::advise_indexes().
+ */
+struct index_report {
+    /**
+     * The indexes that are missing, the ones serving the most queries first.
+     */
+    std::vector<index_suggestion> missing;
+
+    /**
+     * The names of the indexes that support none of the recorded queries. The _id index is never
+     * listed.
+     */
+    std::vector<std::string> unused;
+};
+
+/**
+ * Compares recorded queries with a set of indexes, to find the queries that lack a supporting
+ * index and the indexes that no query uses.
+ *
+ * The comparison is a heuristic that works on query shapes alone: a query counts as supported
+ * if the first key of an index is one of the fields it filters on, or, for queries without a
+ * filter, if the keys of an index start with its sort order. Queries that neither filter nor sort
+ * are ignored. Suggested indexes follow the equality, sort, range rule, and queries that would be
+ * served by the same suggested index are grouped together.
+ *
+ * @param queries  The recorded queries, see query_recorder::queries().
+ * @param indexes  The indexes to compare against, e.g. the indexes listed by the server, or the
+ *                 indexes declared by a model with MANGROVE_INDEXES.
+ */
+inline index_report advise_indexes(const std::vector<recorded_query>& queries,
+                                   const std::vector<index_spec>& indexes) {
+    index_report report;
+    std::vector<bool> used(indexes.size(), false);
+
+    for (const auto& query : queries) {
+        if (!details::is_selective(query)) {
+            continue;
+        }
+
+        bool supported = false;
+        for (std::size_t i = 0; i < indexes.size(); ++i) {
+            if (details::supports_query(indexes[i], query)) {
+                supported = used[i] = true;
+            }
+        }
+        if (supported || query.text_search) {
+            continue;
+        }
+
+        auto keys = details::suggest_index_keys(query);
+        auto same_keys = [&](const index_suggestion& s) {
+            return details::same_index_keys(s.keys.view(), keys.view());
+        };
+        auto it = std::find_if(report.missing.begin(), report.missing.end(), same_keys);
+        if (it == report.missing.end()) {
+            report.missing.push_back(index_suggestion{std::move(keys), {}, 0});
+            it = report.missing.end() - 1;
+        }
+        it->shapes.push_back(query.operation + " " + query.shape);
+        it->queries += query.count;
+    }
+
+    std::stable_sort(report.missing.begin(), report.missing.end(),
+                     [](const index_suggestion& a, const index_suggestion& b) {
+                         return a.queries > b.queries;
+                     });
+
+    for (std::size_t i = 0; i < indexes.size(); ++i) {
+        if (!used[i] && indexes[i].name() != "_id_") {
+            report.unused.push_back(indexes[i].name());
+        }
+    }
+    return report;
+}
+
+MANGROVE_INLINE_NAMESPACE_END
+}  // namespace mangrove
+
+#include <mangrove/config/postlude.hpp>
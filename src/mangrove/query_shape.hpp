@@ -0,0 +1,165 @@
+// Copyright 2016 MongoDB Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <mangrove/config/prelude.hpp>
+
+#include <string>
+
+#include <bsoncxx/array/view.hpp>
+#include <bsoncxx/document/view.hpp>
+#include <bsoncxx/types.hpp>
+#include <mongocxx/options/find.hpp>
+
+namespace mangrove {
+MANGROVE_INLINE_NAMESPACE_BEGIN
+
+namespace details {
+
+inline void append_shape(std::string& out, bsoncxx::document::view doc);
+
+// Returns true if the document is an operator expression, e.g. {$gt: 5}.
+inline bool is_operator_document(bsoncxx::document::view doc) {
+    auto first = doc.begin();
+    return first != doc.end() && !first->key().empty() && first->key()[0] == '$';
+}
+
+// Returns true if the operand of the given operator is a list of clauses, e.g. $or.
+inline bool is_logical_operator(const std::string& key) {
+    return key == "$and" || key == "$or" || key == "$nor";
+}
+
+// Appends the shape of a value that is the operand of the given key.
+inline void append_value_shape(std::string& out, const std::string& key,
+                               const bsoncxx::types::value& value) {
+    bool is_operator = !key.empty() && key[0] == '$';
+
+    if (value.type() == bsoncxx::type::k_document) {
+        auto doc = value.get_document().value;
+        // Sub-documents of operators such as $elemMatch, and operator expressions such as
+        // {$gt: 5}, are part of the shape. Other documents are values to compare against.
+        if (is_operator || is_operator_document(doc)) {
+            append_shape(out, doc);
+            return;
+        }
+    } else if (value.type() == bsoncxx::type::k_array && is_logical_operator(key)) {
+        // The clauses of $and, $or and $nor are part of the shape, but the values of operators
+        // such as $in are not, so that the shape doesn't depend on how many values are given.
+        out += '[';
+        bool first = true;
+        for (const auto& clause : value.get_array().value) {
+            if (!first) {
+                out += ", ";
+            }
+            first = false;
+            if (clause.type() == bsoncxx::type::k_document) {
+                append_shape(out, clause.get_document().value);
+            } else {
+                out += '?';
+            }
+        }
+        out += ']';
+        return;
+    }
+
+    out += '?';
+}
+
+inline void append_shape(std::string& out, bsoncxx::document::view doc) {
+    out += '{';
+    bool first = true;
+    for (const auto& element : doc) {
+        if (!first) {
+            out += ", ";
+        }
+        first = false;
+        std::string key(element.key().data(), element.key().size());
+        out += '"' + key + "\": ";
+        append_value_shape(out, key, element.get_value());
+    }
+    out += '}';
+}
+
+// Appends the shape of a sort document, which keeps the direction of every field.
+inline void append_sort_shape(std::string& out, bsoncxx::document::view sort) {
+    out += '{';
+    bool first = true;
+    for (const auto& element : sort) {
+        if (!first) {
+            out += ", ";
+        }
+        first = false;
+        out += '"' + std::string(element.key().data(), element.key().size()) + "\": ";
+        if (element.type() == bsoncxx::type::k_int32) {
+            out += std::to_string(element.get_int32().value);
+        } else if (element.type() == bsoncxx::type::k_int64) {
+            out += std::to_string(element.get_int64().value);
+        } else if (element.type() == bsoncxx::type::k_double) {
+            out += element.get_double().value < 0 ? "-1" : "1";
+        } else {
+            out += '?';
+        }
+    }
+    out += '}';
+}
+
+}  // namespace details
+
+/**
+ * Computes the shape of a query filter, i.e. the filter with every value that the query compares
+ * against replaced by a placeholder. Queries that differ only in their values, such as
+ * {age: {$gt: 21}} and {age: {$gt: 65}}, have the same shape, {"age": {"$gt": ?}}.
+ *
+ * @param filter The query filter.
+ * @return A string representation of the shape of the filter.
+ */
+inline std::string query_shape(bsoncxx::document::view filter) {
+    std::string shape;
+    details::append_shape(shape, filter);
+    return shape;
+}
+
+/**
+ * Computes the shape of a sorted query, including the fields it sorts by.
+ *
+ * @param filter The query filter.
+ * @param sort The sort order of the query, which may be empty.
+ * @return A string representation of the shape of the query.
+ */
+inline std::string query_shape(bsoncxx::document::view filter, bsoncxx::document::view sort) {
+    auto shape = query_shape(filter);
+    if (!sort.empty()) {
+        shape += " sort ";
+        details::append_sort_shape(shape, sort);
+    }
+    return shape;
+}
+
+/**
+ * Computes the shape of a find() query, including the fields it sorts by.
+ *
+ * @param filter The query filter.
+ * @param options The options of the query.
+ * @return A string representation of the shape of the query.
+ */
+inline std::string query_shape(bsoncxx::document::view filter,
+                               const mongocxx::options::find& options) {
+    return options.sort() ? query_shape(filter, options.sort()->view()) : query_shape(filter);
+}
+
+MANGROVE_INLINE_NAMESPACE_END
+}  // namespace mangrove
+
+#include <mangrove/config/postlude.hpp>
@@ -0,0 +1,327 @@
+// Copyright 2016 MongoDB Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <mangrove/config/prelude.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <bsoncxx/builder/core.hpp>
+#include <bsoncxx/document/value.hpp>
+#include <bsoncxx/oid.hpp>
+#include <bsoncxx/types.hpp>
+#include <mongocxx/options/find.hpp>
+
+#include <mangrove/model.hpp>
+
+namespace mangrove {
+MANGROVE_INLINE_NAMESPACE_BEGIN
+
+/**
+ * Options for a model_queue.
+ */
+struct queue_options {
+    /**
+     * How long claimed jobs stay invisible to other workers. Jobs that are neither acknowledged
+     * nor extended within this time become visible again and are claimed by another worker.
+     */
+    std::chrono::milliseconds visibility_timeout{30000};
+
+    /**
+     * The shortest delay that poll() waits before claiming again when the queue is running low.
+     * Must be positive, since the delay of an idle queue grows by doubling it.
+     */
+    std::chrono::milliseconds min_backoff{10};
+
+    /**
+     * The longest delay that poll() waits before claiming again when the queue is empty.
+     */
+    std::chrono::milliseconds max_backoff{5000};
+};
+
+/**
+ * A batch of jobs claimed from a model_queue. The jobs are held by the claim token until they are
+ * acknowledged, released, or their visibility timeout expires.
+ */
+template <typename T>
+struct claimed_jobs {
+    bsoncxx::oid token;
+    std::vector<T> jobs;
+};
+
+/**
+ * A work queue stored in the collection of a model class, from which many workers claim jobs in
+ * batches.
+ *
+ * Every document of the collection is a job. Jobs are enqueued by inserting objects of T as usual,
+ * and are claimed in _id order, i.e. first-in first-out for ObjectIds. The queue keeps its own
+ * state in a "_queue" subdocument that T doesn't need to map:
+ *
+ *     _queue: {token: <claim token>, visible_at: <date>, attempts: <number of claims>}
+ *
+ * claim() takes up to N jobs with three round-trips regardless of N: it reads the _ids of up to N
+ * visible jobs, marks those that are still visible with a fresh claim token in one update_many,
+ * and then fetches the jobs holding the token. Jobs taken by a concurrent worker between the
+ * first two steps are simply not returned. Acknowledging, releasing and extending a batch are
+ * each a single bulk update on its token.
+ *
+ * Visibility is decided by the clocks of the workers, which should therefore be kept in sync.
+ * An index on {"_queue.visible_at": 1} speeds up claims on large queues.
+ *
+ * A model_queue is not thread-safe; each worker thread should have its own.
+ *
+ * @tparam T The model class of the jobs. Must derive from model<T, IdType>.
+ * @tparam IdType The type of the model's _id field.
+ */
+template <typename T, typename IdType = bsoncxx::oid>
+class model_queue {
+   public:
+    /**
+     * Creates a queue over the collection of T.
+     *
+     * @throws std::logic_error if the visibility timeout or the minimum backoff is not positive,
+     *         or the backoff delays are out of order.
+     */
+    model_queue(const queue_options& options = queue_options()) : _options(options), _delay(0) {
+        if (_options.visibility_timeout.count() <= 0) {
+            throw std::logic_error("The visibility timeout of a queue must be positive.");
+        }
+        if (_options.min_backoff.count() <= 0 || _options.max_backoff < _options.min_backoff) {
+            throw std::logic_error("The backoff delays of a queue must satisfy 0 < min <= max.");
+        }
+    }
+
+    /**
+     * Claims up to max_jobs visible jobs, hiding them from other workers for the visibility
+     * timeout. Also adapts the delay returned by idle_delay() to the number of jobs found.
+     *
+     * @return The claimed jobs and their claim token. The batch is empty if no job was visible.
+     * @throws mongocxx::exception::query or mongocxx::exception::write if a query fails.
+     */
+    claimed_jobs<T> claim(std::size_t max_jobs) {
+        claimed_jobs<T> batch;
+        if (max_jobs == 0) {
+            return batch;
+        }
+
+        auto now = std::chrono::system_clock::now();
+
+        mongocxx::options::find find_options;
+        find_options.projection(id_ascending());
+        find_options.sort(id_ascending());
+        find_options.limit(static_cast<std::int64_t>(max_jobs));
+
+        auto coll = model<T, IdType>::collection();
+        auto ids = bsoncxx::builder::core(true);
+        std::size_t n_candidates = 0;
+        for (auto&& doc : coll.find(visible_filter(now), find_options)) {
+            ids.append(doc["_id"].get_value());
+            ++n_candidates;
+        }
+
+        if (n_candidates > 0) {
+            auto filter = bsoncxx::builder::core(false);
+            filter.key_view("_id");
+            filter.open_document();
+            filter.key_view("$in");
+            filter.append(bsoncxx::types::b_array{ids.view_array()});
+            filter.close_document();
+            filter.concatenate(visible_filter(now).view());
+
+            auto claimed = model<T, IdType>::update_many(
+                filter.extract_document(),
+                claim_update(batch.token, now + _options.visibility_timeout));
+
+            if (!claimed || claimed->modified_count() > 0) {
+                mongocxx::options::find in_order;
+                in_order.sort(id_ascending());
+                for (auto&& job : model<T, IdType>::find(token_filter(batch.token), in_order)) {
+                    batch.jobs.push_back(std::move(job));
+                }
+            }
+        }
+
+        adapt_delay(batch.jobs.size(), max_jobs);
+        return batch;
+    }
+
+    /**
+     * Waits for idle_delay(), then claims up to max_jobs jobs. Calling this in a loop polls the
+     * queue without waiting while it is busy, and increasingly less often while it is empty.
+     *
+     * @see claim()
+     */
+    claimed_jobs<T> poll(std::size_t max_jobs) {
+        if (_delay.count() > 0) {
+            std::this_thread::sleep_for(_delay);
+        }
+        return claim(max_jobs);
+    }
+
+    /**
+     * Returns the delay that poll() waits before its next claim. It is zero after a claim that
+     * filled its batch, grows with the share of the batch left empty, and doubles after every
+     * claim that found nothing, up to queue_options::max_backoff.
+     */
+    std::chrono::milliseconds idle_delay() const {
+        return _delay;
+    }
+
+    /**
+     * Deletes the jobs of a batch that are still held by its claim token. Jobs whose visibility
+     * timeout has expired and that were claimed by another worker are not deleted.
+     *
+     * @return The number of jobs deleted.
+     * @throws mongocxx::exception::write if the delete fails.
+     */
+    std::int64_t ack(const claimed_jobs<T>& batch) {
+        if (batch.jobs.empty()) {
+            return 0;
+        }
+        auto result = model<T, IdType>::delete_many(token_filter(batch.token));
+        return result ? result->deleted_count() : 0;
+    }
+
+    /**
+     * Makes the jobs of a batch that are still held by its claim token visible again after the
+     * given delay, so that they are retried, possibly by another worker.
+     *
+     * @return The number of jobs released.
+     * @throws mongocxx::exception::write if the update fails.
+     */
+    std::int64_t release(const claimed_jobs<T>& batch,
+                         std::chrono::milliseconds delay = std::chrono::milliseconds{0}) {
+        if (batch.jobs.empty()) {
+            return 0;
+        }
+
+        auto update = bsoncxx::builder::core(false);
+        update.key_view("$set");
+        update.open_document();
+        update.key_view("_queue.visible_at");
+        update.append(bsoncxx::types::b_date{std::chrono::system_clock::now() + delay});
+        update.close_document();
+        update.key_view("$unset");
+        update.open_document();
+        update.key_view("_queue.token");
+        update.append("");
+        update.close_document();
+
+        auto result =
+            model<T, IdType>::update_many(token_filter(batch.token), update.extract_document());
+        return result ? result->modified_count() : 0;
+    }
+
+    /**
+     * Extends the visibility timeout of the jobs of a batch that are still held by its claim
+     * token, for workers that need longer than the timeout to process them.
+     *
+     * @return The number of jobs extended.
+     * @throws mongocxx::exception::write if the update fails.
+     */
+    std::int64_t extend(const claimed_jobs<T>& batch) {
+        if (batch.jobs.empty()) {
+            return 0;
+        }
+
+        auto update = bsoncxx::builder::core(false);
+        update.key_view("$set");
+        update.open_document();
+        update.key_view("_queue.visible_at");
+        update.append(bsoncxx::types::b_date{std::chrono::system_clock::now() +
+                                             _options.visibility_timeout});
+        update.close_document();
+
+        auto result =
+            model<T, IdType>::update_many(token_filter(batch.token), update.extract_document());
+        return result ? result->modified_count() : 0;
+    }
+
+   private:
+    // {_id: 1}, used both as a projection and as a sort order.
+    static bsoncxx::document::value id_ascending() {
+        auto builder = bsoncxx::builder::core(false);
+        builder.key_view("_id");
+        builder.append(std::int32_t{1});
+        return builder.extract_document();
+    }
+
+    // Matches the jobs that were never claimed, or whose visibility timeout has expired. $not
+    // also matches the documents without the field.
+    static bsoncxx::document::value visible_filter(std::chrono::system_clock::time_point now) {
+        auto builder = bsoncxx::builder::core(false);
+        builder.key_view("_queue.visible_at");
+        builder.open_document();
+        builder.key_view("$not");
+        builder.open_document();
+        builder.key_view("$gt");
+        builder.append(bsoncxx::types::b_date{now});
+        builder.close_document();
+        builder.close_document();
+        return builder.extract_document();
+    }
+
+    static bsoncxx::document::value token_filter(const bsoncxx::oid& token) {
+        auto builder = bsoncxx::builder::core(false);
+        builder.key_view("_queue.token");
+        builder.append(token);
+        return builder.extract_document();
+    }
+
+    static bsoncxx::document::value claim_update(const bsoncxx::oid& token,
+                                                 std::chrono::system_clock::time_point until) {
+        auto builder = bsoncxx::builder::core(false);
+        builder.key_view("$set");
+        builder.open_document();
+        builder.key_view("_queue.token");
+        builder.append(token);
+        builder.key_view("_queue.visible_at");
+        builder.append(bsoncxx::types::b_date{until});
+        builder.close_document();
+        builder.key_view("$inc");
+        builder.open_document();
+        builder.key_view("_queue.attempts");
+        builder.append(std::int32_t{1});
+        builder.close_document();
+        return builder.extract_document();
+    }
+
+    // A full batch means that more jobs are probably waiting, so the next claim shouldn't wait. A
+    // partial batch means that the queue is running low, and an empty one that it is idle.
+    void adapt_delay(std::size_t n_claimed, std::size_t max_jobs) {
+        if (n_claimed >= max_jobs) {
+            _delay = std::chrono::milliseconds{0};
+        } else if (n_claimed > 0) {
+            auto empty_share = static_cast<std::int64_t>(max_jobs - n_claimed);
+            _delay = _options.min_backoff * empty_share / static_cast<std::int64_t>(max_jobs);
+        } else {
+            _delay = std::max(_options.min_backoff, std::min(_delay * 2, _options.max_backoff));
+        }
+    }
+
+    const queue_options _options;
+    std::chrono::milliseconds _delay;
+};
+
+MANGROVE_INLINE_NAMESPACE_END
+}  // namespace mangrove
+
+#include <mangrove/config/postlude.hpp>
@@ -0,0 +1,257 @@
+// Copyright 2016 MongoDB Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <mangrove/config/prelude.hpp>
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <bsoncxx/builder/core.hpp>
+#include <bsoncxx/stdx/optional.hpp>
+
+#include <boson/bson_archiver.hpp>
+#include <mangrove/deserializing_cursor.hpp>
+#include <mangrove/id_filter.hpp>
+#include <mangrove/model.hpp>
+#include <mangrove/util.hpp>
+
+namespace mangrove {
+MANGROVE_INLINE_NAMESPACE_BEGIN
+
+/**
+ * A reference to an object of another model, stored as the _id of that object.
+ *
+ * A ref<M> is saved and queried exactly like a field holding the id itself. The referenced object
+ * is not loaded along with the referencing object; use mangrove::populate() to load the objects
+ * referenced by a whole batch of objects at once, instead of one find_one() per reference.
+ *
+ * @tparam M A model class, i.e. a class inheriting from mangrove::model<M, IdType>.
+ */
+template <typename M>
+class ref {
+   public:
+    using id_type = typename M::id_type;
+    using model_type = M;
+
+    ref() = default;
+
+    /**
+     * Creates a reference to the object with the given id.
+     */
+    ref(id_type id) : _id(std::move(id)) {
+    }
+
+    /**
+     * Returns the id of the referenced object.
+     */
+    const id_type& id() const {
+        return _id;
+    }
+
+    /**
+     * Returns true if the referenced object has been loaded by populate() and exists.
+     */
+    bool is_loaded() const {
+        return static_cast<bool>(_object);
+    }
+
+    /**
+     * Returns the referenced object.
+     *
+     * @throws std::logic_error if the object has not been loaded, or doesn't exist.
+     */
+    const M& get() const {
+        if (!_object) {
+            throw std::logic_error("The referenced object has not been loaded.");
+        }
+        return *_object;
+    }
+
+    const M& operator*() const {
+        return get();
+    }
+
+    const M* operator->() const {
+        return &get();
+    }
+
+    /**
+     * Sets the referenced object, or clears it if obj is null. Objects referenced by several refs
+     * are shared between them. This is called by populate().
+     */
+    void set_object(std::shared_ptr<const M> obj) {
+        _object = std::move(obj);
+    }
+
+    template <class Archive>
+    void save(Archive& ar) const {
+        ar(_id);
+    }
+
+    template <class Archive>
+    void load(Archive& ar) {
+        ar(_id);
+        _object.reset();
+    }
+
+   private:
+    id_type _id{};
+    std::shared_ptr<const M> _object;
+};
+
+// A ref<M> is a single element, the id of the referenced object, so it does not start or finish a
+// node of its own.
+
+template <typename M>
+inline void prologue(boson::BSONOutputArchive&, const ref<M>&) {
+}
+
+template <typename M>
+inline void epilogue(boson::BSONOutputArchive&, const ref<M>&) {
+}
+
+template <typename M>
+inline void prologue(boson::BSONInputArchive&, const ref<M>&) {
+}
+
+template <typename M>
+inline void epilogue(boson::BSONInputArchive&, const ref<M>&) {
+}
+
+// References are appended to queries as the id they hold.
+template <typename M>
+void append_value_to_bson(const ref<M>& r, bsoncxx::builder::core& builder) {
+    append_value_to_bson(r.id(), builder);
+}
+
+namespace details {
+
+// Type trait containing the referenced model of a field that holds one or several ref<M>.
+template <typename F, typename = void>
+struct ref_target {};
+
+template <typename M>
+struct ref_target<ref<M>> {
+    using type = M;
+};
+
+template <typename M>
+struct ref_target<bsoncxx::stdx::optional<ref<M>>> {
+    using type = M;
+};
+
+template <typename Iterable>
+struct ref_target<Iterable, std::enable_if_t<is_iterable_v<Iterable>>>
+    : ref_target<std::decay_t<decltype(*std::begin(std::declval<Iterable&>()))>> {};
+
+template <typename M, typename F>
+void for_each_ref(ref<M>& r, const F& f) {
+    f(r);
+}
+
+template <typename M, typename F>
+void for_each_ref(bsoncxx::stdx::optional<ref<M>>& r, const F& f) {
+    if (r) {
+        f(*r);
+    }
+}
+
+template <typename Iterable, typename F, typename = std::enable_if_t<is_iterable_v<Iterable>>>
+void for_each_ref(Iterable& refs, const F& f) {
+    for (auto& r : refs) {
+        for_each_ref(r, f);
+    }
+}
+
+}  // namespace details
+
+/**
+ * Loads the objects referenced by a field of every object in a batch, using the batched lookups
+ * of M::find_by_ids(): the ids referenced across the whole batch are fetched with {_id: {$in:
+ * [...]}} queries of at most options.chunk_size ids, rather than with one query per reference.
+ *
+ * References to objects that don't exist are left unloaded.
+ *
+ * @param objects
+ *   A range of objects, such as a std::vector<T>, whose references are populated in place.
+ * @param field
+ *   A pointer to the member holding the references, which may be a ref<M>, an optional ref<M>,
+ *   or a container of ref<M>, e.g. &Restaurant::inspectors.
+ * @param options
+ *   The chunk size and parallelism of the queries, see mangrove::batch_options.
+ *
+ * @throws mongocxx::exception::query if any of the queries fails.
+ */
+template <typename Range, typename T, typename F,
+          typename M = typename details::ref_target<F>::type>
+void populate(Range& objects, F T::*field, const batch_options& options = batch_options()) {
+    std::unordered_map<std::string, std::shared_ptr<const M>> loaded;
+    std::vector<typename M::id_type> ids;
+
+    for (auto& obj : objects) {
+        details::for_each_ref(obj.*field, [&](ref<M>& r) {
+            auto key = details::id_key(details::id_filter(r.id()).view());
+            if (loaded.emplace(std::move(key), nullptr).second) {
+                ids.push_back(r.id());
+            }
+        });
+    }
+
+    if (ids.empty()) {
+        return;
+    }
+
+    auto found = M::find_by_ids(ids, options);
+    for (std::size_t i = 0; i < ids.size(); ++i) {
+        if (found[i]) {
+            auto key = details::id_key(details::id_filter(ids[i]).view());
+            loaded[key] = std::make_shared<const M>(std::move(*found[i]));
+        }
+    }
+
+    for (auto& obj : objects) {
+        details::for_each_ref(obj.*field, [&](ref<M>& r) {
+            r.set_object(loaded[details::id_key(details::id_filter(r.id()).view())]);
+        });
+    }
+}
+
+/**
+ * Reads every object from a cursor, and loads the objects referenced by the given field.
+ *
+ * @return The objects read from the cursor, with their references populated.
+ * @see populate(Range&, F T::*, const batch_options&)
+ */
+template <typename T, typename F, typename M = typename details::ref_target<F>::type>
+std::vector<T> populate(deserializing_cursor<T> cursor, F T::*field,
+                        const batch_options& options = batch_options()) {
+    std::vector<T> objects;
+    for (auto&& obj : cursor) {
+        objects.push_back(std::move(obj));
+    }
+    populate(objects, field, options);
+    return objects;
+}
+
+MANGROVE_INLINE_NAMESPACE_END
+}  // namespace mangrove
+
+#include <mangrove/config/postlude.hpp>
@@ -0,0 +1,176 @@
+// Copyright 2016 MongoDB Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <mangrove/config/prelude.hpp>
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <bsoncxx/builder/core.hpp>
+#include <bsoncxx/document/element.hpp>
+#include <bsoncxx/types.hpp>
+#include <mongocxx/collection.hpp>
+#include <mongocxx/options/find_one_and_update.hpp>
+#include <mongocxx/options/find_one_common_options.hpp>
+
+namespace mangrove {
+MANGROVE_INLINE_NAMESPACE_BEGIN
+
+/**
+ * Allocates increasing integer ids from a named counter stored in a MongoDB collection, using the
+ * hi/lo algorithm.
+ *
+ * Instead of incrementing the counter once per id, the sequence reserves a whole block of ids with
+ * a single atomic $inc, and then hands them out from memory until the block is exhausted. Several
+ * processes may share a counter, since each one reserves disjoint blocks. Ids are unique, but only
+ * increasing within a block: ids from different processes interleave, and the unused ids of a
+ * block are lost when the process exits.
+ *
+ * The counter is stored as {_id: <name>, value: <last reserved id>}. The first id is 1. The value
+ * may be a 32-bit or 64-bit integer, or a double holding an integer below 2^53, as created by the
+ * mongo shell.
+ *
+ * next() is safe to call from multiple threads. Every call loads the current block with
+ * std::atomic_load() on a std::shared_ptr, which standard libraries usually implement with a small
+ * pool of mutexes, and increments the block's atomic counter. Reserving a new block additionally
+ * holds a mutex of the sequence for the duration of the round-trip.
+ */
+class id_sequence {
+   public:
+    /**
+     * Creates a sequence.
+     *
+     * @param counters
+     *   The collection holding the counters. The collection is only used to reserve blocks, which
+     *   never happens concurrently, but its client must not be used by other threads at the same
+     *   time, e.g. a client acquired from a pool and dedicated to the sequence.
+     * @param name
+     *   The name of the counter, e.g. the name of the collection the ids are used in.
+     * @param block_size
+     *   The number of ids reserved at a time.
+     *
+     * @throws std::logic_error if block_size is not positive.
+     */
+    id_sequence(mongocxx::collection counters, std::string name, std::int64_t block_size = 100)
+        : _counters(std::move(counters)),
+          _name(std::move(name)),
+          _block_size(block_size),
+          _block(std::make_shared<block>(0, 0)) {
+        if (_block_size <= 0) {
+            throw std::logic_error("The block size of a sequence must be positive.");
+        }
+    }
+
+    id_sequence(const id_sequence&) = delete;
+    id_sequence& operator=(const id_sequence&) = delete;
+
+    /**
+     * Returns the next id, reserving a new block first if the current one is exhausted.
+     *
+     * @throws mongocxx::exception::write if reserving a block fails.
+     * @throws std::logic_error if the counter does not hold an integral value.
+     */
+    std::int64_t next() {
+        for (;;) {
+            auto current = std::atomic_load(&_block);
+            auto id = current->next.fetch_add(1);
+            if (id < current->end) {
+                return id;
+            }
+            refill(current);
+        }
+    }
+
+   private:
+    // A range [next, end) of reserved ids.
+    struct block {
+        block(std::int64_t begin, std::int64_t end) : next(begin), end(end) {
+        }
+
+        std::atomic<std::int64_t> next;
+        const std::int64_t end;
+    };
+
+    // Reserves a new block, unless another thread already replaced the exhausted one.
+    void refill(const std::shared_ptr<block>& exhausted) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (std::atomic_load(&_block) != exhausted) {
+            return;
+        }
+
+        auto filter = bsoncxx::builder::core(false);
+        filter.key_view("_id");
+        filter.append(_name);
+
+        auto update = bsoncxx::builder::core(false);
+        update.key_view("$inc");
+        update.open_document();
+        update.key_view("value");
+        update.append(_block_size);
+        update.close_document();
+
+        mongocxx::options::find_one_and_update options;
+        options.upsert(true);
+        options.return_document(mongocxx::options::return_document::k_after);
+
+        auto counter = _counters.find_one_and_update(filter.view_document(),
+                                                     update.view_document(), options);
+        if (!counter) {
+            throw std::logic_error("The counter of sequence " + _name + " was not returned.");
+        }
+
+        auto last = last_reserved(counter->view()["value"]);
+        std::atomic_store(&_block, std::make_shared<block>(last - _block_size + 1, last + 1));
+    }
+
+    // Reads the value of the counter, which is a double if the counter was created by the shell.
+    std::int64_t last_reserved(bsoncxx::document::element value) const {
+        switch (value ? value.type() : bsoncxx::type::k_undefined) {
+            case bsoncxx::type::k_int32:
+                return value.get_int32().value;
+            case bsoncxx::type::k_int64:
+                return value.get_int64().value;
+            case bsoncxx::type::k_double: {
+                auto d = value.get_double().value;
+                if (std::trunc(d) == d && std::abs(d) < 9007199254740992.0) {
+                    return static_cast<std::int64_t>(d);
+                }
+                break;
+            }
+            default:
+                break;
+        }
+        throw std::logic_error("The counter of sequence " + _name +
+                               " does not hold an integer or an integral double.");
+    }
+
+    mongocxx::collection _counters;
+    const std::string _name;
+    const std::int64_t _block_size;
+    std::mutex _mutex;
+    std::shared_ptr<block> _block;
+};
+
+MANGROVE_INLINE_NAMESPACE_END
+}  // namespace mangrove
+
+#include <mangrove/config/postlude.hpp>
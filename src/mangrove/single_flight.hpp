@@ -0,0 +1,93 @@
+// Copyright 2016 MongoDB Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <mangrove/config/prelude.hpp>
+
+#include <exception>
+#include <future>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace mangrove {
+MANGROVE_INLINE_NAMESPACE_BEGIN
+
+/**
+ * Coalesces concurrent calls that share a key, so that only one of them does the actual work.
+ *
+ * The first caller for a given key runs the function it was given. Callers that arrive with the
+ * same key while it is running wait for it to finish and receive a copy of its result, or have
+ * its exception rethrown. Once the call completes, the next caller for the key starts a new one.
+ *
+ * @tparam Result The type returned by the coalesced calls. Must be copy constructible.
+ */
+template <typename Result>
+class single_flight {
+   public:
+    single_flight() = default;
+
+    single_flight(const single_flight&) = delete;
+    single_flight& operator=(const single_flight&) = delete;
+
+    /**
+     * Runs fn, unless a call with the same key is already in flight, in which case its result is
+     * shared instead.
+     *
+     * @param key
+     *   Identifies calls that are interchangeable, e.g. the BSON of a query.
+     * @param fn
+     *   A callable with the signature Result().
+     *
+     * @return The result of fn, or of the in-flight call with the same key.
+     */
+    template <typename Fn>
+    Result run(const std::string& key, Fn&& fn) {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        auto it = _calls.find(key);
+        if (it != _calls.end()) {
+            auto pending = it->second;
+            lock.unlock();
+            return pending.get();
+        }
+
+        std::promise<Result> promise;
+        auto result = promise.get_future().share();
+        _calls.emplace(key, result);
+        lock.unlock();
+
+        try {
+            promise.set_value(fn());
+        } catch (...) {
+            promise.set_exception(std::current_exception());
+        }
+
+        lock.lock();
+        _calls.erase(key);
+        lock.unlock();
+
+        return result.get();
+    }
+
+   private:
+    std::mutex _mutex;
+    std::unordered_map<std::string, std::shared_future<Result>> _calls;
+};
+
+MANGROVE_INLINE_NAMESPACE_END
+}  // namespace mangrove
+
+#include <mangrove/config/postlude.hpp>
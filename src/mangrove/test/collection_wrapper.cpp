@@ -15,6 +15,8 @@
 #include "catch.hpp"
 
 #include <iostream>
+#include <string>
+#include <vector>
 
 #include <bsoncxx/builder/stream/document.hpp>
 #include <mongocxx/client.hpp>
@@ -23,7 +25,11 @@
 #include <mongocxx/stdx.hpp>
 
 #include <boson/bson_streambuf.hpp>
+#include <mangrove/array_projection.hpp>
 #include <mangrove/collection_wrapper.hpp>
+#include <mangrove/macros.hpp>
+#include <mangrove/nvp.hpp>
+#include <mangrove/projection.hpp>
 
 using namespace bsoncxx;
 using namespace mongocxx;
@@ -224,3 +230,136 @@ TEST_CASE(
 
     coll.delete_many({});
 }
+
+// A lightweight view of Foo documents that maps only two of their fields.
+class FooView {
+   public:
+    int a, c;
+
+    MANGROVE_MAKE_KEYS(FooView, MANGROVE_NVP(a), MANGROVE_NVP(c))
+};
+
+// A view that keeps the raw document it was read from, which must therefore be read in full.
+class RawFooView : public boson::UnderlyingBSONDataBase {
+   public:
+    int a;
+
+    MANGROVE_MAKE_KEYS(RawFooView, MANGROVE_NVP(a))
+};
+
+TEST_CASE("collection_wrapper projects reads onto the fields mapped by the result type.",
+          "[mangrove::collection_wrapper]") {
+    REQUIRE(projection_for<FooView>()->view() == from_json(R"({"a": 1, "c": 1, "_id": 0})"));
+    REQUIRE(!projection_for<Foo>());
+    REQUIRE(!projection_for<RawFooView>());
+
+    instance::current();
+    client conn{uri{}};
+    collection coll = conn["testdb"]["testcollection"];
+    collection_wrapper<Foo> foo_coll(coll);
+
+    coll.delete_many({});
+    coll.insert_one(from_json(R"({"a": 1, "b": 4, "c": 9, "padding": "unused"})"));
+
+    auto res = foo_coll.find_one<FooView>({});
+    REQUIRE(res);
+    REQUIRE(res->a == 1);
+    REQUIRE(res->c == 9);
+
+    int i = 0;
+    for (FooView v : foo_coll.find<FooView>({})) {
+        REQUIRE(v.c == 9);
+        i++;
+    }
+    REQUIRE(i == 1);
+
+    pipeline stages;
+    stages.match(from_json(R"({"a": 1})"));
+    i = 0;
+    for (FooView v : foo_coll.aggregate<FooView>(stages)) {
+        REQUIRE(v.a == 1);
+        i++;
+    }
+    REQUIRE(i == 1);
+
+    SECTION("Automatic projection can be turned off.") {
+        foo_coll.set_auto_projection(false);
+        REQUIRE(!foo_coll.projected<FooView>(options::find{}).projection());
+        REQUIRE(foo_coll.find_one<FooView>({}));
+    }
+
+    SECTION("A projection passed by the caller is kept.") {
+        options::find opts;
+        opts.projection(from_json(R"({"a": 1})"));
+        REQUIRE(foo_coll.projected<FooView>(opts).projection()->view() ==
+                from_json(R"({"a": 1})"));
+    }
+}
+
+class Scores {
+   public:
+    std::string name;
+    std::string notes;
+    std::vector<int> values;
+
+    MANGROVE_MAKE_KEYS(Scores, MANGROVE_NVP(name), MANGROVE_NVP(notes), MANGROVE_NVP(values))
+};
+
+// A view of Scores documents that skips the notes.
+class ScoresView {
+   public:
+    std::string name;
+    std::vector<int> values;
+
+    MANGROVE_MAKE_KEYS(ScoresView, MANGROVE_NVP(name), MANGROVE_NVP(values))
+};
+
+TEST_CASE("array projections read only part of an array field.",
+          "[mangrove::array_projection]") {
+    REQUIRE(slice_projection(MANGROVE_KEY(Scores::values), -2).view() ==
+            from_json(R"({"values": {"$slice": -2}})"));
+    REQUIRE(slice_projection(MANGROVE_KEY(Scores::values), 1, 2).view() ==
+            from_json(R"({"values": {"$slice": [1, 2]}})"));
+    REQUIRE(projection_with<ScoresView>(slice_projection(MANGROVE_KEY(Scores::values), -2))
+                .view() ==
+            from_json(R"({"name": 1, "values": {"$slice": -2}, "_id": 0})"));
+
+    instance::current();
+    client conn{uri{}};
+    collection coll = conn["testdb"]["testcollection"];
+    collection_wrapper<Scores> scores_coll(coll);
+
+    coll.delete_many({});
+    coll.insert_one(from_json(R"({"name": "a", "notes": "long text", "values": [1, 2, 3, 4, 5]})"));
+
+    SECTION("The partial array is decoded into the same member of the model class.") {
+        options::find opts;
+        opts.projection(slice_projection(MANGROVE_KEY(Scores::values), -2));
+        auto res = scores_coll.find_one({}, opts);
+        REQUIRE(res);
+        REQUIRE(res->notes == "long text");
+        REQUIRE(res->values == std::vector<int>{4, 5});
+    }
+
+    SECTION("The partial array is decoded into a view type.") {
+        options::find opts;
+        opts.projection(projection_with<ScoresView>(
+            slice_projection(MANGROVE_KEY(Scores::values), 1, 2)));
+        auto res = scores_coll.find_one<ScoresView>({}, opts);
+        REQUIRE(res);
+        REQUIRE(res->values == std::vector<int>{2, 3});
+    }
+
+    SECTION("$elemMatch returns the first matching element.") {
+        // A bare $elemMatch projection only returns _id and the array, hence the view type.
+        options::find opts;
+        opts.projection(projection_with<ScoresView>(elem_match_projection(
+            MANGROVE_KEY(Scores::values), MANGROVE_ELEM(Scores::values) > 3)));
+        auto res = scores_coll.find_one<ScoresView>({}, opts);
+        REQUIRE(res);
+        REQUIRE(res->name == "a");
+        REQUIRE(res->values == std::vector<int>{4});
+    }
+
+    coll.delete_many({});
+}
@@ -0,0 +1,115 @@
+// Copyright 2016 MongoDB Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch.hpp"
+
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <bsoncxx/json.hpp>
+#include <mongocxx/client.hpp>
+#include <mongocxx/instance.hpp>
+
+#include <mangrove/geo.hpp>
+#include <mangrove/macros.hpp>
+#include <mangrove/model.hpp>
+#include <mangrove/nvp.hpp>
+#include <mangrove/query_builder.hpp>
+
+using mangrove::geo_point;
+using mangrove::geo_polygon;
+
+struct Place : public mangrove::model<Place> {
+    std::string name;
+    geo_point location;
+
+    MANGROVE_MAKE_KEYS_MODEL(Place, MANGROVE_NVP(name), MANGROVE_NVP(location))
+};
+
+TEST_CASE("geospatial operators build GeoJSON queries.", "[mangrove::geo_expr]") {
+    bsoncxx::document::view_or_value near =
+        MANGROVE_KEY(Place::location).near(geo_point{2.35, 48.85}, 1000.0);
+    REQUIRE(bsoncxx::to_json(near.view()) ==
+            bsoncxx::to_json(bsoncxx::from_json(
+                R"({"location": {"$near": {"$geometry": {"type": "Point", )"
+                R"("coordinates": [2.35, 48.85]}, "$maxDistance": 1000.0}}})")));
+
+    // Rings are closed automatically.
+    std::vector<geo_point> corners{{0, 0}, {1, 0}, {0, 1}};
+    geo_polygon triangle{corners};
+    REQUIRE(triangle.coordinates()[0].size() == 4);
+    REQUIRE(triangle.coordinates()[0].back() == triangle.coordinates()[0].front());
+
+    corners.pop_back();
+    REQUIRE_THROWS_AS(geo_polygon{corners}, std::logic_error);
+
+    // Geospatial queries combine with other queries.
+    bsoncxx::document::view_or_value both =
+        (MANGROVE_KEY(Place::name) == "Louvre" &&
+         MANGROVE_KEY(Place::location).geo_intersects(triangle));
+    REQUIRE(both.view()["$and"]);
+}
+
+TEST_CASE("geospatial queries use a 2dsphere index on GeoJSON points.", "[mangrove::geo_expr]") {
+    mongocxx::instance{};
+    mongocxx::client conn{mongocxx::uri{}};
+
+    auto db = conn["mangrove_geo_test"];
+    Place::setCollection(db["places"]);
+    Place::drop();
+
+    auto places = Place::collection();
+    places.create_index(mangrove::geo_index_keys(MANGROVE_KEY(Place::location)));
+
+    Place louvre;
+    louvre.name = "Louvre";
+    louvre.location = geo_point{2.3376, 48.8606};
+    Place orsay;
+    orsay.name = "Orsay";
+    orsay.location = geo_point{2.3266, 48.8600};
+    Place versailles;
+    versailles.name = "Versailles";
+    versailles.location = geo_point{2.1204, 48.8049};
+    Place::insert_one(louvre);
+    Place::insert_one(orsay);
+    Place::insert_one(versailles);
+
+    // Points round-trip through BSON.
+    auto found = Place::find_one(MANGROVE_KEY(Place::name) == "Versailles");
+    REQUIRE(found);
+    REQUIRE(found->location == versailles.location);
+
+    // $near sorts by distance.
+    std::vector<std::string> names;
+    for (auto p : Place::find(MANGROVE_KEY(Place::location).near(orsay.location, 5000.0))) {
+        names.push_back(p.name);
+    }
+    REQUIRE(names == (std::vector<std::string>{"Orsay", "Louvre"}));
+
+    auto within_2km = MANGROVE_KEY(Place::location)
+                          .geo_within(mangrove::geo_center_sphere{louvre.location,
+                                                                  mangrove::earth_radians(2000)});
+    REQUIRE(Place::count(within_2km) == 2);
+
+    geo_polygon paris{std::vector<geo_point>{{2.22, 48.81}, {2.47, 48.81}, {2.47, 48.91},
+                                             {2.22, 48.91}}};
+    REQUIRE(Place::count(MANGROVE_KEY(Place::location).geo_within(paris)) == 2);
+
+    // $near and $nearSphere are not allowed in counts.
+    auto nearby =
+        Place::find(MANGROVE_KEY(Place::location).near_sphere(versailles.location, 100.0));
+    REQUIRE(std::distance(nearby.begin(), nearby.end()) == 1);
+}
@@ -0,0 +1,96 @@
+// Copyright 2016 MongoDB Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch.hpp"
+
+#include <chrono>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <bsoncxx/json.hpp>
+#include <mongocxx/client.hpp>
+#include <mongocxx/instance.hpp>
+
+#include <mangrove/index.hpp>
+#include <mangrove/macros.hpp>
+#include <mangrove/model.hpp>
+#include <mangrove/nvp.hpp>
+#include <mangrove/query_builder.hpp>
+
+struct Account : public mangrove::model<Account> {
+    std::string email;
+    std::string country;
+    int32_t age;
+    std::string bio;
+    bool active;
+    std::chrono::system_clock::time_point last_seen;
+
+    MANGROVE_MAKE_KEYS_MODEL(Account, MANGROVE_NVP(email), MANGROVE_NVP(country),
+                             MANGROVE_NVP(age), MANGROVE_NVP(bio), MANGROVE_NVP(active),
+                             MANGROVE_NVP(last_seen))
+
+    MANGROVE_INDEXES(
+        mangrove::index(MANGROVE_KEY(Account::email)).unique(),
+        mangrove::index(MANGROVE_KEY(Account::country), MANGROVE_KEY(Account::age).sort(false)),
+        mangrove::index(MANGROVE_KEY(Account::last_seen)).expire_after(std::chrono::hours{24}),
+        mangrove::index(MANGROVE_KEY(Account::age))
+            .partial(MANGROVE_KEY(Account::active) == true)
+            .name("active_age"),
+        mangrove::text_index(MANGROVE_KEY(Account::bio)))
+};
+
+TEST_CASE("index specs take their keys and names from name-value pairs.", "[mangrove::index]") {
+    auto specs = Account::declared_indexes();
+    REQUIRE(specs.size() == 5);
+
+    REQUIRE(bsoncxx::to_json(specs[1].keys()) ==
+            bsoncxx::to_json(bsoncxx::from_json(R"({"country": 1, "age": -1})")));
+    REQUIRE(specs[1].name() == "country_1_age_-1");
+    REQUIRE(specs[3].name() == "active_age");
+    REQUIRE(specs[4].name() == "bio_text");
+
+    REQUIRE(bsoncxx::to_json(specs[0].options()) ==
+            bsoncxx::to_json(bsoncxx::from_json(R"({"name": "email_1", "unique": true})")));
+    REQUIRE(specs[2].options().view()["expireAfterSeconds"].get_int32().value == 86400);
+    REQUIRE(specs[3].options().view()["partialFilterExpression"]["active"].get_bool().value);
+
+    REQUIRE(mangrove::details::same_index_keys(bsoncxx::from_json(R"({"a": 1.0, "b": -1})"),
+                                               bsoncxx::from_json(R"({"a": 1, "b": -1.0})")));
+    REQUIRE_FALSE(mangrove::details::same_index_keys(bsoncxx::from_json(R"({"a": 1, "b": 1})"),
+                                                     bsoncxx::from_json(R"({"a": 1})")));
+}
+
+TEST_CASE("ensure_indexes() creates only the missing indexes.", "[mangrove::index]") {
+    mongocxx::instance{};
+    mongocxx::client conn{mongocxx::uri{}};
+
+    auto db = conn["mangrove_index_test"];
+    Account::setCollection(db["accounts"]);
+    Account::drop();
+
+    // An index created by hand under another name is recognized by its keys.
+    auto accounts = Account::collection();
+    accounts.create_index(bsoncxx::from_json(R"({"email": 1})"),
+                          bsoncxx::from_json(R"({"name": "by_email", "unique": true})"));
+
+    auto created = Account::ensure_indexes();
+    REQUIRE(created == (std::vector<std::string>{"country_1_age_-1", "last_seen_1",
+                                                  "active_age", "bio_text"}));
+
+    auto indexes = accounts.list_indexes();
+    REQUIRE(std::distance(indexes.begin(), indexes.end()) == 6);
+
+    REQUIRE(Account::ensure_indexes().empty());
+}
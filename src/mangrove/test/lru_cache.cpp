@@ -0,0 +1,111 @@
+// Copyright 2016 MongoDB Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch.hpp"
+
+#include <thread>
+
+#include <mangrove/lru_cache.hpp>
+
+using namespace mangrove;
+
+TEST_CASE("lru_cache evicts the least recently used entries once over its byte bound.",
+          "[mangrove::lru_cache]") {
+    cache_options options;
+    options.max_bytes = 100;
+    options.shards = 1;
+
+    lru_cache<int> cache(options);
+
+    cache.put("a", 1, 40);
+    cache.put("b", 2, 40);
+
+    // Touch "a" so that "b" becomes the least recently used entry.
+    REQUIRE(cache.get("a").value() == 1);
+
+    cache.put("c", 3, 40);
+
+    REQUIRE(!cache.get("b"));
+    REQUIRE(cache.get("a").value() == 1);
+    REQUIRE(cache.get("c").value() == 3);
+
+    auto stats = cache.stats();
+    REQUIRE(stats.hits == 3);
+    REQUIRE(stats.misses == 1);
+    REQUIRE(stats.evictions == 1);
+    REQUIRE(stats.entries == 2);
+    REQUIRE(stats.bytes == 80);
+
+    SECTION("Values larger than the bound are not cached.") {
+        cache.put("d", 4, 200);
+        REQUIRE(!cache.get("d"));
+        REQUIRE(cache.stats().entries == 2);
+    }
+
+    SECTION("Entries can be erased or cleared.") {
+        cache.erase("a");
+        REQUIRE(!cache.get("a"));
+        REQUIRE(cache.stats().entries == 1);
+
+        cache.clear();
+        REQUIRE(cache.stats().entries == 0);
+        REQUIRE(cache.stats().bytes == 0);
+    }
+}
+
+TEST_CASE("lru_cache entries expire after their TTL.", "[mangrove::lru_cache]") {
+    cache_options options;
+    options.ttl = std::chrono::milliseconds(10);
+
+    lru_cache<std::string> cache(options);
+
+    cache.put("key", "value", 5);
+    REQUIRE(cache.get("key").value() == "value");
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    REQUIRE(!cache.get("key"));
+    REQUIRE(cache.stats().entries == 0);
+}
+
+TEST_CASE("lru_cache discards values read before an invalidation of their key.",
+          "[mangrove::lru_cache]") {
+    lru_cache<int> cache;
+
+    // A reader captures the generation, then fetches the value from the source...
+    auto generation = cache.generation("a");
+
+    SECTION("An erase() between the fetch and the put discards the stale value.") {
+        cache.erase("a");
+        REQUIRE(!cache.put("a", 1, 10, generation));
+        REQUIRE(!cache.get("a"));
+    }
+
+    SECTION("A clear() between the fetch and the put discards the stale value.") {
+        cache.clear();
+        REQUIRE(!cache.put("a", 1, 10, generation));
+        REQUIRE(!cache.get("a"));
+    }
+
+    SECTION("Without an invalidation, the value is cached.") {
+        REQUIRE(cache.put("a", 1, 10, generation));
+        REQUIRE(cache.get("a").value() == 1);
+
+        // A later reader that captured the new generation may cache again.
+        cache.erase("a");
+        auto next = cache.generation("a");
+        REQUIRE(cache.put("a", 2, 10, next));
+        REQUIRE(cache.get("a").value() == 2);
+    }
+}
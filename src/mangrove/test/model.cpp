@@ -14,17 +14,24 @@
 
 #include "catch.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
 #include <bsoncxx/builder/stream/document.hpp>
 
 #include <boson/stdx/optional.hpp>
 
 #include <mongocxx/client.hpp>
 #include <mongocxx/instance.hpp>
+#include <mongocxx/pool.hpp>
 
 #include <mangrove/macros.hpp>
 #include <mangrove/model.hpp>
 #include <mangrove/nvp.hpp>
 #include <mangrove/query_builder.hpp>
+#include <mangrove/ref.hpp>
 
 struct DataA : public mangrove::model<DataA> {
     int32_t x, y;
@@ -467,3 +474,530 @@ TEST_CASE(
 
     REQUIRE(DataA::count(MANGROVE_KEY(DataA::y) == 229) == 2);
 }
+
+TEST_CASE("the model base class can atomically update a document and return it.",
+          "[mangrove::model]") {
+    mongocxx::instance{};
+    mongocxx::client conn{mongocxx::uri{}};
+
+    auto db = conn["mangrove_model_test"];
+
+    DataA::setCollection(db["data_a"]);
+    DataA::drop();
+
+    DataA single;
+    single.x = 1;
+    single.y = 2;
+    single.z = 3.0;
+    single.save();
+
+    auto before =
+        DataA::find_one_and_update(MANGROVE_KEY(DataA::x) == 1, MANGROVE_KEY(DataA::y) += 5);
+    REQUIRE(before);
+    REQUIRE(before->y == 2);
+
+    mongocxx::options::find_one_and_update opts;
+    opts.return_document(mongocxx::options::return_document::k_after);
+    auto after =
+        DataA::find_one_and_update(MANGROVE_KEY(DataA::x) == 1, MANGROVE_KEY(DataA::y) += 5, opts);
+    REQUIRE(after);
+    REQUIRE(after->y == 12);
+
+    REQUIRE(!DataA::find_one_and_update(MANGROVE_KEY(DataA::x) == 2, MANGROVE_KEY(DataA::y) = 0));
+}
+
+TEST_CASE("the model base class can cache lookups by _id across calls.", "[mangrove::model]") {
+    mongocxx::instance{};
+    mongocxx::client conn{mongocxx::uri{}};
+
+    auto db = conn["mangrove_model_test"];
+
+    DataA::setCollection(db["data_a"]);
+    DataA::drop();
+    DataA::enable_cache();
+
+    DataA a;
+    a.x = 1;
+    a.y = 2;
+    a.z = 3.0;
+    a.save();
+
+    REQUIRE(DataA::find_by_id(a.getID())->x == 1);
+    REQUIRE(DataA::cache_stats().misses == 1);
+
+    REQUIRE(DataA::find_by_id(a.getID())->x == 1);
+    REQUIRE(DataA::cache_stats().hits == 1);
+
+    // Writes through the model invalidate the cached object.
+    a.x = 5;
+    a.save();
+    REQUIRE(DataA::find_by_id(a.getID())->x == 5);
+
+    DataA::update_many(MANGROVE_KEY(DataA::y) == 2, MANGROVE_KEY(DataA::x) = 7);
+    REQUIRE(DataA::find_by_id(a.getID())->x == 7);
+
+    a.remove();
+    REQUIRE(!DataA::find_by_id(a.getID()));
+
+    DataA::disable_cache();
+    REQUIRE(DataA::cache_stats().hits == 0);
+}
+
+TEST_CASE("the model base class can cache query results until the next write.",
+          "[mangrove::model]") {
+    mongocxx::instance{};
+    mongocxx::client conn{mongocxx::uri{}};
+
+    auto db = conn["mangrove_model_test"];
+
+    DataA::setCollection(db["data_a"]);
+    DataA::drop();
+    DataA::enable_query_cache();
+
+    std::vector<DataA> data(3);
+    for (auto& a : data) {
+        a.x = 1;
+    }
+    DataA::insert_many(data);
+
+    auto first = DataA::find_cached(MANGROVE_KEY(DataA::x) == 1);
+    REQUIRE(first->size() == 3);
+
+    auto second = DataA::find_cached(MANGROVE_KEY(DataA::x) == 1);
+    REQUIRE(second == first);
+    REQUIRE(DataA::query_cache_stats().hits == 1);
+
+    // Different options are cached separately.
+    mongocxx::options::find opts;
+    opts.limit(1);
+    REQUIRE(DataA::find_cached(MANGROVE_KEY(DataA::x) == 1, opts)->size() == 1);
+
+    DataA other;
+    other.x = 1;
+    other.save();
+
+    auto third = DataA::find_cached(MANGROVE_KEY(DataA::x) == 1);
+    REQUIRE(third != first);
+    REQUIRE(third->size() == 4);
+
+    DataA::disable_query_cache();
+}
+
+TEST_CASE("the model base class can fetch many objects by _id in input order.",
+          "[mangrove::model]") {
+    mongocxx::instance{};
+    mongocxx::client conn{mongocxx::uri{}};
+
+    auto db = conn["mangrove_model_test"];
+
+    DataA::setCollection(db["data_a"]);
+    DataA::drop();
+
+    std::vector<bsoncxx::oid> ids;
+    for (int32_t i = 0; i < 5; ++i) {
+        DataA a;
+        a.x = i;
+        a.save();
+        ids.push_back(a.getID());
+    }
+
+    bsoncxx::oid missing;
+    std::vector<bsoncxx::oid> query{ids[4], missing, ids[0], ids[2], ids[4]};
+
+    mangrove::batch_options options;
+    options.chunk_size = 2;
+
+    auto results = DataA::find_by_ids(query, options);
+
+    REQUIRE(results.size() == 5);
+    REQUIRE(results[0]->x == 4);
+    REQUIRE(!results[1]);
+    REQUIRE(results[2]->x == 0);
+    REQUIRE(results[3]->x == 2);
+    REQUIRE(results[4]->x == 4);
+
+    // A document that doesn't decode is an error rather than a missing id.
+    bsoncxx::oid corrupt;
+    DataA::collection().insert_one(bsoncxx::builder::stream::document{}
+                                   << "_id" << corrupt << "x"
+                                   << "not a number" << bsoncxx::builder::stream::finalize);
+    REQUIRE_THROWS_AS(DataA::find_by_ids(std::vector<bsoncxx::oid>{ids[0], corrupt}),
+                      boson::Exception);
+}
+
+TEST_CASE("the model base class can read a single field without decoding whole objects.",
+          "[mangrove::model]") {
+    mongocxx::instance{};
+    mongocxx::client conn{mongocxx::uri{}};
+
+    auto db = conn["mangrove_model_test"];
+
+    DataA::setCollection(db["data_a"]);
+    DataA::drop();
+
+    for (int32_t i = 0; i < 4; ++i) {
+        DataA a;
+        a.x = i;
+        a.y = i % 2;
+        a.z = 0.5;
+        a.save();
+    }
+
+    int32_t sum = 0;
+    int count = 0;
+    for (int32_t x : DataA::find_values(MANGROVE_KEY(DataA::x), MANGROVE_KEY(DataA::y) == 1)) {
+        sum += x;
+        count++;
+    }
+    REQUIRE(count == 2);
+    REQUIRE(sum == 4);
+
+    auto ys = DataA::distinct(MANGROVE_KEY(DataA::y));
+    std::sort(ys.begin(), ys.end());
+    REQUIRE(ys == std::vector<int32_t>{0, 1});
+
+    REQUIRE(DataA::distinct(MANGROVE_KEY(DataA::z), MANGROVE_KEY(DataA::x) > 1) ==
+            std::vector<double>{0.5});
+}
+
+TEST_CASE("the model base class can report fields that are fetched but never read.",
+          "[mangrove::model]") {
+    mongocxx::instance{};
+    mongocxx::client conn{mongocxx::uri{}};
+
+    auto db = conn["mangrove_model_test"];
+
+    DataA::setCollection(db["data_a"]);
+    DataA::drop();
+
+    auto coll = DataA::collection();
+    coll.insert_one(bsoncxx::builder::stream::document{}
+                    << "x" << 1 << "y" << 2 << "z" << 0.5 << "w"
+                    << "unused" << bsoncxx::builder::stream::finalize);
+
+    // Fetch whole documents, so that the unmapped field is fetched.
+    DataA::set_auto_projection(false);
+    DataA::enable_field_access_tracking();
+
+    for (auto&& a : DataA::find(MANGROVE_KEY(DataA::x) > 0)) {
+        REQUIRE(a.x == 1);
+    }
+    REQUIRE(DataA::find_one(MANGROVE_KEY(DataA::x) == 1));
+
+    auto report = DataA::field_usage_report();
+    REQUIRE(report.size() == 2);
+
+    for (const auto& shape : report) {
+        REQUIRE(shape.documents == 1);
+
+        auto w = std::find_if(shape.fields.begin(), shape.fields.end(),
+                              [](const mangrove::field_usage& f) { return f.name == "w"; });
+        REQUIRE(w != shape.fields.end());
+        REQUIRE(w->fetched == 1);
+        REQUIRE(w->read == 0);
+        REQUIRE(!w->deferred);
+
+        REQUIRE(shape.suggested_projection);
+        REQUIRE(shape.suggested_projection->view()["x"]);
+        REQUIRE(!shape.suggested_projection->view()["w"]);
+    }
+
+    DataA::disable_field_access_tracking();
+    DataA::set_auto_projection(true);
+    REQUIRE(DataA::field_usage_report().empty());
+}
+
+TEST_CASE("the model base class can page through documents by range instead of skip().",
+          "[mangrove::model]") {
+    mongocxx::instance{};
+    mongocxx::client conn{mongocxx::uri{}};
+
+    auto db = conn["mangrove_model_test"];
+
+    DataA::setCollection(db["data_a"]);
+    DataA::drop();
+
+    // Many documents share the same value of x, so that pages must be split between them.
+    for (int32_t i = 0; i < 10; ++i) {
+        DataA a;
+        a.x = i % 3;
+        a.y = i;
+        a.z = 0.5;
+        a.save();
+    }
+
+    auto pages =
+        DataA::paginate(MANGROVE_KEY(DataA::z) == 0.5, MANGROVE_KEY(DataA::x).sort(false), 4);
+
+    std::vector<int32_t> xs, ys;
+    int page_count = 0;
+    while (pages.has_more()) {
+        auto page = pages.next_page();
+        if (page.empty()) {
+            break;
+        }
+        page_count++;
+        for (const auto& a : page) {
+            xs.push_back(a.x);
+            ys.push_back(a.y);
+        }
+    }
+
+    REQUIRE(page_count == 3);
+    REQUIRE(xs.size() == 10);
+    REQUIRE(std::is_sorted(xs.rbegin(), xs.rend()));
+    std::sort(ys.begin(), ys.end());
+    REQUIRE(std::adjacent_find(ys.begin(), ys.end()) == ys.end());
+    REQUIRE(pages.next_page().empty());
+
+    SECTION("A paginator can resume from the position of another one.") {
+        auto first = DataA::paginate({}, (MANGROVE_KEY(DataA::x).sort(true),
+                                          MANGROVE_KEY(DataA::y).sort(true)),
+                                     5);
+        auto page = first.next_page();
+        REQUIRE(page.size() == 5);
+
+        auto second = DataA::paginate({}, (MANGROVE_KEY(DataA::x).sort(true),
+                                           MANGROVE_KEY(DataA::y).sort(true)),
+                                      5, mongocxx::options::find{}, first.position());
+        auto rest = second.next_page();
+        REQUIRE(rest.size() == 5);
+        REQUIRE(!second.has_more());
+        REQUIRE(rest.front().x >= page.back().x);
+    }
+}
+
+TEST_CASE("the model base class can scan a collection in several partitions.",
+          "[mangrove::model]") {
+    mongocxx::instance{};
+    mongocxx::client conn{mongocxx::uri{}};
+
+    auto db = conn["mangrove_model_test"];
+
+    DataA::setCollection(db["data_a"]);
+    DataA::drop();
+
+    std::vector<DataA> objects;
+    for (int32_t i = 0; i < 500; ++i) {
+        DataA a;
+        a.x = i;
+        a.y = i % 7;
+        a.z = 0.5;
+        objects.push_back(a);
+    }
+    DataA::insert_many(objects);
+
+    std::mutex mutex;
+    std::vector<int32_t> xs;
+    auto collect = [&](DataA a) {
+        std::lock_guard<std::mutex> lock(mutex);
+        xs.push_back(a.x);
+    };
+
+    SECTION("Partitions are ranges of _id.") {
+        DataA::parallel_scan(MANGROVE_KEY(DataA::y) != 0, 4, collect);
+        REQUIRE(xs.size() == 428);
+    }
+
+    SECTION("Partitions are ranges of another field.") {
+        DataA::parallel_scan(MANGROVE_KEY(DataA::x), {}, 4, collect);
+        REQUIRE(xs.size() == 500);
+    }
+
+    SECTION("With a pool, partitions are scanned on worker threads.") {
+        mongocxx::pool pool{mongocxx::uri{}};
+        DataA::set_pool(pool, "mangrove_model_test", "data_a");
+
+        // Unbind the pool before it is destroyed, even if a check fails.
+        struct pool_binding_guard {
+            ~pool_binding_guard() {
+                DataA::clear_pool();
+            }
+        } guard;
+
+        std::vector<std::thread::id> threads;
+        DataA::parallel_scan(MANGROVE_KEY(DataA::y) != 0, 4, [&](DataA a) {
+            std::lock_guard<std::mutex> lock(mutex);
+            xs.push_back(a.x);
+            threads.push_back(std::this_thread::get_id());
+        });
+        REQUIRE(xs.size() == 428);
+        REQUIRE(std::find(threads.begin(), threads.end(), std::this_thread::get_id()) ==
+                threads.end());
+        std::sort(xs.begin(), xs.end());
+        REQUIRE(std::adjacent_find(xs.begin(), xs.end()) == xs.end());
+
+        xs.clear();
+        DataA::parallel_scan(MANGROVE_KEY(DataA::x), {}, 4, collect);
+        REQUIRE(xs.size() == 500);
+    }
+
+    std::sort(xs.begin(), xs.end());
+    REQUIRE(std::adjacent_find(xs.begin(), xs.end()) == xs.end());
+}
+
+TEST_CASE("the model base class can query objects by the creation time in their _id.",
+          "[mangrove::model]") {
+    mongocxx::instance{};
+    mongocxx::client conn{mongocxx::uri{}};
+
+    auto db = conn["mangrove_model_test"];
+
+    DataA::setCollection(db["data_a"]);
+    DataA::drop();
+
+    auto epoch = std::chrono::system_clock::time_point{};
+    REQUIRE(mangrove::min_oid_for(epoch + std::chrono::seconds(1)).to_string() ==
+            "000000010000000000000000");
+    REQUIRE(mangrove::max_oid_for(epoch + std::chrono::milliseconds(1500)).to_string() ==
+            "00000001ffffffffffffffff");
+
+    auto before = std::chrono::system_clock::now() - std::chrono::seconds(1);
+    for (int32_t i = 0; i < 3; ++i) {
+        DataA a;
+        a.x = i;
+        a.y = 0;
+        a.z = 0.5;
+        a.save();
+    }
+    auto after = std::chrono::system_clock::now() + std::chrono::seconds(1);
+
+    REQUIRE(DataA::count(DataA::created_between(before, after)) == 3);
+    REQUIRE(DataA::count(DataA::created_after(after)) == 0);
+    REQUIRE(DataA::count(DataA::created_before(before)) == 0);
+    REQUIRE(DataA::count(DataA::created_after(before) && MANGROVE_KEY(DataA::x) > 0) == 2);
+
+    mongocxx::options::find opts;
+    opts.sort(DataA::id_key().sort(false));
+    auto newest = DataA::find_one(DataA::created_after(before), opts);
+    REQUIRE(newest);
+    REQUIRE(newest->x == 2);
+}
+
+// Struct with an integer _id assigned from a sequence
+struct DataE : public mangrove::model<DataE, std::int64_t> {
+    int32_t x;
+
+    MANGROVE_MAKE_KEYS_MODEL(DataE, MANGROVE_NVP(x))
+
+    std::int64_t getID() {
+        return _id;
+    }
+};
+
+TEST_CASE("the model base class can assign integer _ids from a sequence.", "[mangrove::model]") {
+    mongocxx::instance{};
+    mongocxx::client conn{mongocxx::uri{}};
+    mongocxx::client counters_conn{mongocxx::uri{}};
+
+    auto db = conn["mangrove_model_test"];
+    auto counters = counters_conn["mangrove_model_test"]["counters"];
+    counters.drop();
+
+    DataE::setCollection(db["data_e"]);
+    DataE::drop();
+    DataE::set_id_sequence(std::make_shared<mangrove::id_sequence>(counters, "data_e", 3));
+
+    DataE first;
+    first.x = 0;
+    DataE::insert_one(first);
+    REQUIRE(first.getID() == 1);
+
+    // The ids are assigned to the caller's objects, so saving them again updates the same
+    // documents.
+    std::vector<DataE> objects(5);
+    for (int32_t i = 0; i < 5; ++i) {
+        objects[i].x = i + 1;
+    }
+    DataE::insert_many(objects);
+    REQUIRE(objects[0].getID() == 2);
+    REQUIRE(objects[4].getID() == 6);
+
+    DataE last;
+    last.x = 6;
+    last.save();
+    REQUIRE(last.getID() == 7);
+
+    first.x = 10;
+    first.save();
+    REQUIRE(DataE::count() == 7);
+
+    std::vector<std::int64_t> ids;
+    for (auto&& e : DataE::find({})) {
+        ids.push_back(e.getID());
+    }
+    std::sort(ids.begin(), ids.end());
+    REQUIRE(ids == std::vector<std::int64_t>{1, 2, 3, 4, 5, 6, 7});
+
+    // Three blocks of three ids were reserved.
+    auto counter = counters.find_one(bsoncxx::builder::stream::document{}
+                                     << "_id"
+                                     << "data_e" << bsoncxx::builder::stream::finalize);
+    REQUIRE(counter);
+    REQUIRE(counter->view()["value"].get_int64().value == 9);
+
+    // Counters created by the shell hold doubles, which are read as long as they are integral.
+    counters.insert_one(bsoncxx::builder::stream::document{}
+                        << "_id"
+                        << "shell" << "value" << 41.0 << bsoncxx::builder::stream::finalize);
+    REQUIRE(mangrove::id_sequence(counters, "shell", 1).next() == 42);
+
+    counters.insert_one(bsoncxx::builder::stream::document{}
+                        << "_id"
+                        << "fractional" << "value" << 0.5 << bsoncxx::builder::stream::finalize);
+    REQUIRE_THROWS_AS(mangrove::id_sequence(counters, "fractional", 1).next(), std::logic_error);
+
+    DataE::set_id_sequence(nullptr);
+}
+
+// Struct referencing objects of DataE by _id
+struct DataF : public mangrove::model<DataF> {
+    int32_t x;
+    mangrove::ref<DataE> owner;
+    std::vector<mangrove::ref<DataE>> members;
+
+    MANGROVE_MAKE_KEYS_MODEL(DataF, MANGROVE_NVP(x), MANGROVE_NVP(owner), MANGROVE_NVP(members))
+};
+
+TEST_CASE("the model base class can populate references to other models in one batch.",
+          "[mangrove::model]") {
+    mongocxx::instance{};
+    mongocxx::client conn{mongocxx::uri{}};
+
+    auto db = conn["mangrove_model_test"];
+    DataE::setCollection(db["data_e"]);
+    DataF::setCollection(db["data_f"]);
+    DataE::drop();
+    DataF::drop();
+
+    for (int64_t i = 1; i <= 3; ++i) {
+        db["data_e"].insert_one(bsoncxx::builder::stream::document{}
+                                << "_id" << i << "x" << static_cast<int32_t>(i * 10)
+                                << bsoncxx::builder::stream::finalize);
+    }
+
+    for (int32_t i = 0; i < 2; ++i) {
+        DataF f;
+        f.x = i;
+        f.owner = mangrove::ref<DataE>{1 + i};
+        f.members = {mangrove::ref<DataE>{2}, mangrove::ref<DataE>{3}, mangrove::ref<DataE>{42}};
+        f.save();
+    }
+
+    // The references are stored as plain ids, and can be queried as such.
+    REQUIRE(DataF::count(MANGROVE_KEY(DataF::owner) == mangrove::ref<DataE>{2}) == 1);
+
+    auto objects = mangrove::populate(DataF::find({}), &DataF::members);
+    REQUIRE(objects.size() == 2);
+    for (const auto& f : objects) {
+        REQUIRE(!f.owner.is_loaded());
+        REQUIRE(f.members.size() == 3);
+        REQUIRE(f.members[0]->x == 20);
+        REQUIRE(f.members[1].get().x == 30);
+        REQUIRE(!f.members[2].is_loaded());
+        REQUIRE_THROWS_AS(f.members[2].get(), std::logic_error);
+    }
+
+    mangrove::populate(objects, &DataF::owner);
+    REQUIRE((*objects[0].owner).x + objects[1].owner->x == 30);
+}
@@ -0,0 +1,176 @@
+// Copyright 2016 MongoDB Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch.hpp"
+
+#include <string>
+#include <vector>
+
+#include <bsoncxx/json.hpp>
+#include <mongocxx/client.hpp>
+#include <mongocxx/config/version.hpp>
+#include <mongocxx/instance.hpp>
+
+#include <mangrove/macros.hpp>
+#include <mangrove/model.hpp>
+#include <mangrove/pipeline_builder.hpp>
+#include <mangrove/update_pipeline.hpp>
+
+using bsoncxx::from_json;
+using mangrove::pipeline_builder;
+using namespace mangrove::accumulators;
+
+struct Sale : public mangrove::model<Sale> {
+    std::string region;
+    std::string status;
+    int32_t amount;
+    std::vector<std::string> tags;
+
+    MANGROVE_MAKE_KEYS_MODEL(Sale, MANGROVE_NVP(region), MANGROVE_NVP(status),
+                             MANGROVE_NVP(amount), MANGROVE_NVP(tags))
+};
+
+struct RegionReport {
+    std::string _id;
+    int32_t total;
+    double average;
+    int32_t largest;
+    int32_t sales;
+
+    MANGROVE_MAKE_KEYS(RegionReport, MANGROVE_NVP(_id), MANGROVE_NVP(total),
+                       MANGROVE_NVP(average), MANGROVE_NVP(largest), MANGROVE_NVP(sales))
+};
+
+TEST_CASE("pipeline_builder builds stages from name-value pairs", "[mangrove::pipeline_builder]") {
+    pipeline_builder stages;
+    stages.match(MANGROVE_KEY(Sale::status) == "paid")
+        .unwind(MANGROVE_KEY(Sale::tags))
+        .group(MANGROVE_KEY(Sale::region),
+               sum(MANGROVE_KEY(RegionReport::total), MANGROVE_KEY(Sale::amount)),
+               count(MANGROVE_KEY(RegionReport::sales)))
+        .sort(MANGROVE_KEY(RegionReport::total).sort(false))
+        .limit(3);
+
+    auto expected = from_json(R"({"stages": [
+        {"$match": {"status": {"$eq": "paid"}}},
+        {"$unwind": "$tags"},
+        {"$group": {"_id": "$region", "total": {"$sum": "$amount"}, "sales": {"$sum": 1}}},
+        {"$sort": {"total": -1}},
+        {"$limit": 3}]})");
+
+    REQUIRE(stages.pipeline().view_array() == expected.view()["stages"].get_array().value);
+
+    SECTION("Sub-pipelines can be combined with $facet.") {
+        pipeline_builder by_region, by_status;
+        by_region.group(MANGROVE_KEY(Sale::region), count(MANGROVE_KEY(RegionReport::sales)));
+        by_status.group(MANGROVE_KEY(Sale::status), count(MANGROVE_KEY(RegionReport::sales)));
+
+        pipeline_builder facets;
+        facets.facet({{"by_region", by_region}, {"by_status", by_status}});
+
+        auto stage = facets.pipeline().view_array()[0].get_document().value;
+        REQUIRE(stage["$facet"]["by_region"][0]["$group"]["_id"].get_utf8().value ==
+                bsoncxx::stdx::string_view{"$region"});
+        REQUIRE(stage["$facet"]["by_status"]);
+    }
+}
+
+TEST_CASE("pipeline_builder output is decoded into a result type",
+          "[mangrove::pipeline_builder]") {
+    mongocxx::instance::current();
+    mongocxx::client conn{mongocxx::uri{}};
+
+    Sale::setCollection(conn["mangrove_pipeline_test"]["sales"]);
+    Sale::drop();
+
+    const std::vector<std::pair<std::string, int32_t>> rows{
+        {"north", 10}, {"north", 30}, {"south", 5}, {"south", 7}, {"east", 100}};
+    for (const auto& row : rows) {
+        Sale s;
+        s.region = row.first;
+        s.status = row.second == 100 ? "refunded" : "paid";
+        s.amount = row.second;
+        s.save();
+    }
+
+    pipeline_builder stages;
+    stages.match(MANGROVE_KEY(Sale::status) == "paid")
+        .group(MANGROVE_KEY(Sale::region),
+               sum(MANGROVE_KEY(RegionReport::total), MANGROVE_KEY(Sale::amount)),
+               avg(MANGROVE_KEY(RegionReport::average), MANGROVE_KEY(Sale::amount)),
+               max(MANGROVE_KEY(RegionReport::largest), MANGROVE_KEY(Sale::amount)),
+               count(MANGROVE_KEY(RegionReport::sales)))
+        .sort(MANGROVE_KEY(RegionReport::total).sort(false));
+
+    std::vector<RegionReport> reports;
+    for (RegionReport r : Sale::aggregate<RegionReport>(stages)) {
+        reports.push_back(r);
+    }
+
+    REQUIRE(reports.size() == 2);
+    REQUIRE(reports[0]._id == "north");
+    REQUIRE(reports[0].total == 40);
+    REQUIRE(reports[0].average == 20.0);
+    REQUIRE(reports[0].largest == 30);
+    REQUIRE(reports[0].sales == 2);
+    REQUIRE(reports[1]._id == "south");
+    REQUIRE(reports[1].total == 12);
+}
+
+TEST_CASE("update_pipeline builds update stages from aggregation expressions",
+          "[mangrove::update_pipeline]") {
+    namespace agg = mangrove::agg;
+
+    mangrove::update_pipeline update;
+    update.set(MANGROVE_KEY(Sale::amount), agg::multiply(MANGROVE_KEY(Sale::amount), 2))
+        .set(MANGROVE_KEY(Sale::status),
+             agg::cond(agg::gt(MANGROVE_KEY(Sale::amount), 50), "$large", "small"))
+        .unset(MANGROVE_KEY(Sale::tags));
+
+    auto expected = from_json(R"({"stages": [
+        {"$set": {"amount": {"$multiply": ["$amount", 2]}}},
+        {"$set": {"status": {"$cond": [{"$gt": ["$amount", 50]},
+                                       {"$literal": "$large"}, {"$literal": "small"}]}}},
+        {"$unset": ["tags"]}]})");
+
+    REQUIRE(update.pipeline().view_array() == expected.view()["stages"].get_array().value);
+
+#if MONGOCXX_VERSION_MAJOR > 3 || (MONGOCXX_VERSION_MAJOR == 3 && MONGOCXX_VERSION_MINOR >= 5)
+    SECTION("Update pipelines run on the server.") {
+        mongocxx::instance::current();
+        mongocxx::client conn{mongocxx::uri{}};
+
+        Sale::setCollection(conn["mangrove_pipeline_test"]["sales"]);
+        Sale::drop();
+
+        Sale s;
+        s.region = "north";
+        s.status = "paid";
+        s.amount = 40;
+        s.tags = {"a", "b"};
+        s.save();
+
+        auto res = Sale::update_many({}, update);
+        REQUIRE(res);
+        REQUIRE(res->modified_count() == 1);
+
+        auto coll = Sale::collection();
+        auto sale = coll.find_one({});
+        REQUIRE(sale);
+        REQUIRE(sale->view()["amount"].get_int32().value == 80);
+        REQUIRE(sale->view()["status"].get_utf8().value == bsoncxx::stdx::string_view{"$large"});
+        REQUIRE(!sale->view()["tags"]);
+    }
+#endif
+}
@@ -22,6 +22,7 @@
 #include <mongocxx/pipeline.hpp>
 #include <mongocxx/stdx.hpp>
 
+#include <mangrove/array_filters.hpp>
 #include <mangrove/collection_wrapper.hpp>
 #include <mangrove/model.hpp>
 #include <mangrove/query_builder.hpp>
@@ -264,6 +265,55 @@ TEST_CASE("Test keys with custom names") {
     REQUIRE(obj.x == 4);
 }
 
+// A model whose fields are stored under compact keys.
+class CompactItem : public mangrove::model<CompactItem> {
+   public:
+    int quantity_in_stock;
+    std::string product_description;
+    Point location;
+
+    MANGROVE_MAKE_KEYS_MODEL_COMPACT(CompactItem, MANGROVE_NVP(quantity_in_stock),
+                                     MANGROVE_NVP(product_description), MANGROVE_NVP(location));
+};
+
+TEST_CASE("Test keys with compact names", "[mangrove::nvp]") {
+    REQUIRE(MANGROVE_KEY(CompactItem::quantity_in_stock).get_name() == "a");
+    REQUIRE((MANGROVE_KEY(CompactItem::location)->*MANGROVE_KEY(Point::x)).get_name() == "c.x");
+
+    auto aliases = mangrove::field_aliases<CompactItem>();
+    REQUIRE(aliases.size() == 4);
+    REQUIRE(aliases[1].first == "product_description");
+    REQUIRE(aliases[1].second == "b");
+    REQUIRE(aliases[3].second == "_id");
+
+    instance::current();
+    client conn{uri{}};
+    auto coll = conn["testdb"]["testcollection"];
+    coll.delete_many({});
+    CompactItem::setCollection(coll);
+
+    CompactItem item;
+    item.quantity_in_stock = 4;
+    item.product_description = "widget";
+    item.location = {1, 2};
+    item.save();
+
+    auto doc = coll.find_one({});
+    REQUIRE(doc);
+    REQUIRE(doc->view()["a"].get_int32().value == 4);
+    REQUIRE(doc->view()["c"]["x"].get_int32().value == 1);
+    REQUIRE(!doc->view()["quantity_in_stock"]);
+
+    CompactItem::update_many(MANGROVE_KEY(CompactItem::quantity_in_stock) == 4,
+                             MANGROVE_KEY(CompactItem::product_description) = "gadget");
+
+    auto res =
+        CompactItem::find_one(MANGROVE_KEY(CompactItem::location)->*MANGROVE_KEY(Point::x) == 1);
+    REQUIRE(res);
+    REQUIRE(res->quantity_in_stock == 4);
+    REQUIRE(res->product_description == "gadget");
+}
+
 TEST_CASE("Test member array access") {
     // Nvp's must be used as temporary objects.
     REQUIRE((MANGROVE_KEY(Bar::arr)[1].get_name() == "arr.1"));
@@ -1135,6 +1185,43 @@ TEST_CASE("Update Builder", "mangrove::update_expr") {
         REQUIRE(bar->arr[1] == 500);
     }
 
+    SECTION("Test $[] and $[<identifier>] array update operators.",
+            "[mangrove::filtered_positional_nvp]") {
+        REQUIRE(MANGROVE_KEY(Bar::arr).all_elements().get_name() == "arr.$[]");
+        REQUIRE((MANGROVE_KEY(Bar::pts).filtered("big")->*MANGROVE_KEY(Point::x)).get_name() ==
+                "pts.$[big].x");
+
+        auto filter = mangrove::array_filter("big", MANGROVE_KEY(Point::x) > 10);
+        REQUIRE(filter.view() == (bsoncxx::builder::stream::document{}
+                                  << "big.x" << bsoncxx::builder::stream::open_document << "$gt"
+                                  << 10 << bsoncxx::builder::stream::close_document
+                                  << bsoncxx::builder::stream::finalize)
+                                     .view());
+
+        options::update opts;
+        opts.array_filters(mangrove::array_filters(filter));
+        auto res = Bar::update_one(
+            MANGROVE_KEY(Bar::w) == 555,
+            (MANGROVE_KEY(Bar::pts).filtered("big")->*MANGROVE_KEY(Point::x) = 0,
+             MANGROVE_KEY(Bar::arr).all_elements() += 1),
+            opts);
+        REQUIRE(res);
+        REQUIRE(res->modified_count() == 1);
+
+        auto bar = Bar::find_one(MANGROVE_KEY(Bar::w) == 555);
+        REQUIRE(bar);
+        REQUIRE(bar->pts[0].x == 9);
+        REQUIRE(bar->pts[1].x == 0);
+        REQUIRE(bar->arr == std::vector<int>{5, 6, 7});
+
+        opts.array_filters(mangrove::array_filters(
+            mangrove::array_filter("small", MANGROVE_ELEM(Bar::arr) < 6)));
+        Bar::update_one(MANGROVE_KEY(Bar::w) == 555, MANGROVE_KEY(Bar::arr).filtered("small") = 0,
+                        opts);
+        bar = Bar::find_one(MANGROVE_KEY(Bar::w) == 555);
+        REQUIRE(bar->arr == std::vector<int>{0, 6, 7});
+    }
+
     SECTION("Test $pop array update operator.", "[mangrove::nvp::pop]") {
         Bar(777, 10, 999, true, "pop", {1, 0}, {4, 5, 6}, {{9, 10}, {11, 12}}, system_clock::now())
             .save();
@@ -0,0 +1,132 @@
+// Copyright 2016 MongoDB Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <bsoncxx/json.hpp>
+#include <mongocxx/client.hpp>
+#include <mongocxx/instance.hpp>
+#include <mongocxx/options/find.hpp>
+
+#include <mangrove/index.hpp>
+#include <mangrove/macros.hpp>
+#include <mangrove/model.hpp>
+#include <mangrove/nvp.hpp>
+#include <mangrove/query_builder.hpp>
+#include <mangrove/query_recorder.hpp>
+
+using bsoncxx::from_json;
+
+TEST_CASE("the index advisor reports unsupported query shapes and unused indexes.",
+          "[mangrove::query_recorder]") {
+    mangrove::query_recorder recorder;
+    recorder.record("find", from_json(R"({"status": "A", "age": {"$gt": 30}})"),
+                    from_json(R"({"name": -1})"));
+    recorder.record("find", from_json(R"({"status": "B", "age": {"$gt": 65}})"),
+                    from_json(R"({"name": -1})"));
+    recorder.record("count", from_json(R"({"email": "a@b.c"})"), {},
+                    std::chrono::microseconds{250});
+    recorder.record("find", from_json("{}"));
+
+    auto queries = recorder.queries();
+    REQUIRE(queries.size() == 3);
+    REQUIRE(queries[0].operation == "find");
+    REQUIRE(queries[0].shape == R"({"status": ?, "age": {"$gt": ?}} sort {"name": -1})");
+    REQUIRE(queries[0].count == 2);
+    REQUIRE(queries[0].timed_count == 0);
+    REQUIRE(queries[0].equality_fields == std::vector<std::string>{"status"});
+    REQUIRE(queries[0].range_fields == std::vector<std::string>{"age"});
+
+    std::vector<mangrove::index_spec> indexes;
+    indexes.emplace_back(from_json(R"({"_id": 1})"));
+    indexes.back().name("_id_");
+    indexes.emplace_back(from_json(R"({"email": 1})"));
+    indexes.emplace_back(from_json(R"({"zip": 1})"));
+
+    auto report = mangrove::advise_indexes(queries, indexes);
+    REQUIRE(report.missing.size() == 1);
+    REQUIRE(bsoncxx::to_json(report.missing[0].keys) ==
+            bsoncxx::to_json(from_json(R"({"status": 1, "name": -1, "age": 1})")));
+    REQUIRE(report.missing[0].queries == 2);
+    REQUIRE(report.unused == std::vector<std::string>{"zip_1"});
+}
+
+struct Visit : public mangrove::model<Visit> {
+    std::string page;
+    int32_t duration;
+
+    MANGROVE_MAKE_KEYS_MODEL(Visit, MANGROVE_NVP(page), MANGROVE_NVP(duration))
+
+    MANGROVE_INDEXES(mangrove::index(MANGROVE_KEY(Visit::page)))
+};
+
+TEST_CASE("models record the shapes of their queries when asked to.",
+          "[mangrove::query_recorder]") {
+    mongocxx::instance{};
+    mongocxx::client conn{mongocxx::uri{}};
+
+    auto db = conn["mangrove_query_recorder_test"];
+    Visit::setCollection(db["visits"]);
+    Visit::drop();
+
+    Visit v;
+    v.page = "/";
+    v.duration = 10;
+    Visit::insert_one(v);
+
+    // Queries are only recorded once recording is enabled.
+    Visit::count(MANGROVE_KEY(Visit::duration) > 5);
+    REQUIRE(Visit::recorded_queries().empty());
+
+    Visit::enable_query_recording();
+    Visit::count(MANGROVE_KEY(Visit::duration) > 5);
+    Visit::count(MANGROVE_KEY(Visit::duration) > 50);
+    Visit::find_one(MANGROVE_KEY(Visit::page) == "/");
+    Visit::update_many(MANGROVE_KEY(Visit::page) == "/", MANGROVE_KEY(Visit::duration) = 20);
+
+    auto queries = Visit::recorded_queries();
+    REQUIRE(queries.size() == 3);
+    REQUIRE(queries[0].operation == "count");
+    REQUIRE(queries[0].count == 2);
+    REQUIRE(queries[0].timed_count == 2);
+
+    // The declared index on page isn't created yet, but still counts as present.
+    auto report = Visit::advise_indexes();
+    REQUIRE(report.missing.size() == 1);
+    REQUIRE(bsoncxx::to_json(report.missing[0].keys) ==
+            bsoncxx::to_json(from_json(R"({"duration": 1})")));
+    REQUIRE(report.unused.empty());
+
+    // Batched, paged and by-object paths are recorded as well.
+    Visit::enable_query_recording();
+    Visit::find_by_ids(std::vector<bsoncxx::oid>{v.getID()});
+    Visit::distinct(MANGROVE_KEY(Visit::page));
+    Visit::paginate({}, MANGROVE_KEY(Visit::duration).sort(true), 10).next_page();
+    v.save();
+
+    std::vector<std::string> operations;
+    for (const auto& query : Visit::recorded_queries()) {
+        operations.push_back(query.operation);
+    }
+    std::sort(operations.begin(), operations.end());
+    REQUIRE(operations == std::vector<std::string>{"distinct", "find_by_ids", "paginate", "save"});
+
+    Visit::disable_query_recording();
+    REQUIRE(Visit::recorded_queries().empty());
+}
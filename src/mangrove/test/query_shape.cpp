@@ -0,0 +1,46 @@
+// Copyright 2016 MongoDB Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch.hpp"
+
+#include <bsoncxx/json.hpp>
+
+#include <mangrove/query_shape.hpp>
+
+using bsoncxx::from_json;
+using mangrove::query_shape;
+
+TEST_CASE("query_shape replaces compared values with placeholders", "[mangrove::query_shape]") {
+    auto a = from_json(R"({"age": {"$gt": 21}, "name": "Ann"})");
+    auto b = from_json(R"({"age": {"$gt": 65}, "name": "Bob"})");
+
+    REQUIRE(query_shape(a.view()) == R"({"age": {"$gt": ?}, "name": ?})");
+    REQUIRE(query_shape(a.view()) == query_shape(b.view()));
+}
+
+TEST_CASE("query_shape keeps the structure of logical operators", "[mangrove::query_shape]") {
+    auto filter = from_json(R"({"$or": [{"a": 1}, {"b": {"$in": [1, 2, 3]}}]})");
+    REQUIRE(query_shape(filter.view()) == R"({"$or": [{"a": ?}, {"b": {"$in": ?}}]})");
+
+    auto embedded = from_json(R"({"address": {"city": "NYC"}})");
+    REQUIRE(query_shape(embedded.view()) == R"({"address": ?})");
+}
+
+TEST_CASE("query_shape includes the sort order of find queries", "[mangrove::query_shape]") {
+    auto filter = from_json(R"({"a": 1})");
+    mongocxx::options::find options;
+    options.sort(from_json(R"({"b": -1, "c": 1})"));
+
+    REQUIRE(query_shape(filter.view(), options) == R"({"a": ?} sort {"b": -1, "c": 1})");
+}
@@ -0,0 +1,106 @@
+// Copyright 2016 MongoDB Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch.hpp"
+
+#include <chrono>
+#include <stdexcept>
+#include <string>
+
+#include <bsoncxx/builder/stream/document.hpp>
+#include <mongocxx/client.hpp>
+#include <mongocxx/instance.hpp>
+
+#include <mangrove/macros.hpp>
+#include <mangrove/model.hpp>
+#include <mangrove/nvp.hpp>
+#include <mangrove/query_builder.hpp>
+#include <mangrove/queue.hpp>
+
+struct Job : public mangrove::model<Job> {
+    std::string task;
+    int32_t n;
+
+    MANGROVE_MAKE_KEYS_MODEL(Job, MANGROVE_NVP(task), MANGROVE_NVP(n))
+};
+
+TEST_CASE("a model queue claims jobs in batches and hides them until acknowledged.",
+          "[mangrove::model_queue]") {
+    mongocxx::instance{};
+    mongocxx::client conn{mongocxx::uri{}};
+
+    auto db = conn["mangrove_queue_test"];
+
+    Job::setCollection(db["jobs"]);
+    Job::drop();
+
+    for (int32_t i = 0; i < 5; ++i) {
+        Job j;
+        j.task = "resize";
+        j.n = i;
+        Job::insert_one(j);
+    }
+
+    // An idle queue doubles its delay, which never grows from zero.
+    mangrove::queue_options no_backoff;
+    no_backoff.min_backoff = std::chrono::milliseconds{0};
+    REQUIRE_THROWS_AS(mangrove::model_queue<Job>{no_backoff}, std::logic_error);
+
+    mangrove::queue_options options;
+    options.min_backoff = std::chrono::milliseconds{30};
+    options.max_backoff = std::chrono::milliseconds{100};
+    mangrove::model_queue<Job> worker_a{options};
+    mangrove::model_queue<Job> worker_b{options};
+
+    auto first = worker_a.claim(3);
+    REQUIRE(first.jobs.size() == 3);
+    REQUIRE(first.jobs[0].n == 0);
+    REQUIRE(worker_a.idle_delay().count() == 0);
+
+    // Claimed jobs are hidden from other workers. A partial batch waits for a share of the
+    // minimum backoff, and empty ones double the delay up to the maximum.
+    auto second = worker_b.claim(3);
+    REQUIRE(second.jobs.size() == 2);
+    REQUIRE(worker_b.idle_delay().count() == 10);
+
+    REQUIRE(worker_b.claim(3).jobs.empty());
+    REQUIRE(worker_b.idle_delay().count() == 30);
+    REQUIRE(worker_b.claim(3).jobs.empty());
+    REQUIRE(worker_b.idle_delay().count() == 60);
+    REQUIRE(worker_b.claim(3).jobs.empty());
+    REQUIRE(worker_b.idle_delay().count() == 100);
+
+    REQUIRE(worker_a.ack(first) == 3);
+    REQUIRE(Job::count() == 2);
+
+    // Released jobs become visible again immediately.
+    REQUIRE(worker_b.release(second) == 2);
+    auto retried = worker_a.claim(10);
+    REQUIRE(retried.jobs.size() == 2);
+
+    // A stale worker can't acknowledge jobs that timed out and were claimed by another. The
+    // timeout is simulated by making the claimed jobs visible again.
+    Job::collection().update_many(
+        bsoncxx::builder::stream::document{} << bsoncxx::builder::stream::finalize,
+        bsoncxx::builder::stream::document{}
+            << "$set" << bsoncxx::builder::stream::open_document << "_queue.visible_at"
+            << bsoncxx::types::b_date{std::chrono::system_clock::time_point{}}
+            << bsoncxx::builder::stream::close_document << bsoncxx::builder::stream::finalize);
+    auto stolen = worker_b.claim(10);
+    REQUIRE(stolen.jobs.size() == 2);
+    REQUIRE(worker_a.ack(retried) == 0);
+    REQUIRE(worker_b.extend(stolen) == 2);
+    REQUIRE(worker_b.ack(stolen) == 2);
+    REQUIRE(Job::count() == 0);
+}
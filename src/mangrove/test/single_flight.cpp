@@ -0,0 +1,79 @@
+// Copyright 2016 MongoDB Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <mangrove/single_flight.hpp>
+
+using namespace mangrove;
+
+TEST_CASE("single_flight shares one in-flight call between concurrent callers.",
+          "[mangrove::single_flight]") {
+    single_flight<int> flights;
+    std::atomic<int> calls{0};
+    std::atomic<bool> started{false};
+    std::promise<void> release;
+    auto released = release.get_future().share();
+
+    auto slow = [&] {
+        ++calls;
+        started = true;
+        released.wait();
+        return 42;
+    };
+
+    auto leader = std::async(std::launch::async, [&] { return flights.run("key", slow); });
+    while (!started) {
+        std::this_thread::yield();
+    }
+
+    std::vector<std::future<int>> followers;
+    for (int i = 0; i < 4; ++i) {
+        followers.push_back(
+            std::async(std::launch::async, [&] { return flights.run("key", slow); }));
+    }
+
+    // Calls with a different key are not coalesced.
+    REQUIRE(flights.run("other", [] { return 7; }) == 7);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    release.set_value();
+
+    REQUIRE(leader.get() == 42);
+    for (auto& f : followers) {
+        REQUIRE(f.get() == 42);
+    }
+    REQUIRE(calls == 1);
+
+    // Once a call has completed, the next one runs again.
+    REQUIRE(flights.run("key", slow) == 42);
+    REQUIRE(calls == 2);
+}
+
+TEST_CASE("single_flight rethrows the exception of the shared call.",
+          "[mangrove::single_flight]") {
+    single_flight<int> flights;
+
+    REQUIRE_THROWS_AS(flights.run("key", []() -> int { throw std::runtime_error("failed"); }),
+                      std::runtime_error);
+
+    REQUIRE(flights.run("key", [] { return 1; }) == 1);
+}
@@ -0,0 +1,144 @@
+// Copyright 2016 MongoDB Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch.hpp"
+
+#include <bsoncxx/builder/stream/document.hpp>
+#include <mongocxx/client.hpp>
+#include <mongocxx/instance.hpp>
+
+#include <mangrove/macros.hpp>
+#include <mangrove/model.hpp>
+#include <mangrove/nvp.hpp>
+#include <mangrove/query_builder.hpp>
+#include <mangrove/unit_of_work.hpp>
+
+struct Account : public mangrove::model<Account> {
+    std::string owner;
+    int32_t balance;
+
+    MANGROVE_MAKE_KEYS_MODEL(Account, MANGROVE_NVP(owner), MANGROVE_NVP(balance))
+
+    bsoncxx::oid getID() {
+        return _id;
+    }
+};
+
+TEST_CASE("a unit of work answers repeated lookups by _id from memory.",
+          "[mangrove::unit_of_work]") {
+    mongocxx::instance{};
+    mongocxx::client conn{mongocxx::uri{}};
+
+    auto db = conn["mangrove_unit_of_work_test"];
+
+    Account::setCollection(db["accounts"]);
+    Account::drop();
+
+    Account a;
+    a.owner = "alice";
+    a.balance = 10;
+    a.save();
+
+    mangrove::unit_of_work<Account> uow;
+
+    Account* first = uow.find_by_id(a.getID());
+    REQUIRE(first);
+    REQUIRE(first->balance == 10);
+
+    // Changes made behind the scope's back are not visible to it.
+    Account::update_many(MANGROVE_KEY(Account::owner) == "alice",
+                         MANGROVE_KEY(Account::balance) = 99);
+
+    Account* second = uow.find_by_id(a.getID());
+    REQUIRE(second == first);
+    REQUIRE(second->balance == 10);
+
+    // Queries by other filters still return the tracked instance.
+    REQUIRE(uow.find_one(MANGROVE_KEY(Account::owner) == "alice") == first);
+
+    REQUIRE(uow.size() == 1);
+    REQUIRE(!uow.has_pending_changes());
+
+    SECTION("Projected lookups are not tracked, and each returns its own object.") {
+        Account b;
+        b.owner = "bob";
+        b.balance = 20;
+        b.save();
+
+        mongocxx::options::find opts;
+        opts.projection(bsoncxx::builder::stream::document{}
+                        << "owner" << 1 << "balance" << 1 << bsoncxx::builder::stream::finalize);
+
+        Account* p1 = uow.find_one(MANGROVE_KEY(Account::owner) == "alice", opts);
+        Account* p2 = uow.find_one(MANGROVE_KEY(Account::owner) == "bob", opts);
+        REQUIRE(p1);
+        REQUIRE(p2);
+        REQUIRE(p1 != first);
+        REQUIRE(p1->owner == "alice");
+        REQUIRE(p2->owner == "bob");
+        REQUIRE(uow.size() == 1);
+    }
+}
+
+TEST_CASE("a unit of work flushes saves and removals in a single commit.",
+          "[mangrove::unit_of_work]") {
+    mongocxx::instance{};
+    mongocxx::client conn{mongocxx::uri{}};
+
+    auto db = conn["mangrove_unit_of_work_test"];
+
+    Account::setCollection(db["accounts"]);
+    Account::drop();
+
+    Account a, b;
+    a.owner = "alice";
+    a.balance = 10;
+    a.save();
+    b.owner = "bob";
+    b.balance = 20;
+    b.save();
+
+    mangrove::unit_of_work<Account> uow;
+
+    Account* alice = uow.find_by_id(a.getID());
+    REQUIRE(alice);
+    alice->balance = 15;
+    uow.save(*alice);
+
+    uow.remove(b);
+    REQUIRE(!uow.find_by_id(b.getID()));
+
+    Account c;
+    c.owner = "carol";
+    c.balance = 30;
+    uow.save(c);
+
+    REQUIRE(uow.has_pending_changes());
+
+    // Nothing has been written yet.
+    REQUIRE(Account::count() == 2);
+    REQUIRE(Account::find_one(MANGROVE_KEY(Account::owner) == "alice")->balance == 10);
+
+    auto result = uow.commit();
+    REQUIRE(result);
+    REQUIRE(!uow.has_pending_changes());
+
+    REQUIRE(Account::count() == 2);
+    REQUIRE(Account::find_one(MANGROVE_KEY(Account::owner) == "alice")->balance == 15);
+    REQUIRE(!Account::find_one(MANGROVE_KEY(Account::owner) == "bob"));
+    REQUIRE(Account::find_one(MANGROVE_KEY(Account::owner) == "carol")->balance == 30);
+
+    // A commit with no pending changes is a no-op.
+    REQUIRE(!uow.commit());
+}
@@ -0,0 +1,299 @@
+// Copyright 2016 MongoDB Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <mangrove/config/prelude.hpp>
+
+#include <deque>
+#include <string>
+#include <unordered_map>
+
+#include <bsoncxx/builder/basic/document.hpp>
+#include <bsoncxx/builder/basic/kvp.hpp>
+#include <bsoncxx/stdx/optional.hpp>
+#include <mongocxx/bulk_write.hpp>
+#include <mongocxx/model/delete_one.hpp>
+#include <mongocxx/model/update_one.hpp>
+#include <mongocxx/options/bulk_write.hpp>
+#include <mongocxx/result/bulk_write.hpp>
+
+#include <boson/mapping_functions.hpp>
+#include <mangrove/id_filter.hpp>
+#include <mangrove/model.hpp>
+
+namespace mangrove {
+MANGROVE_INLINE_NAMESPACE_BEGIN
+
+/**
+ * A scoped identity map for objects of a model class.
+ *
+ * A unit_of_work keeps every object it loads indexed by _id for as long as it lives, so repeated
+ * lookups of the same document within one scope are answered from memory instead of going to the
+ * database and decoding the document again. All lookups of a given _id through the same scope
+ * return the same tracked instance.
+ *
+ * Objects passed to save() and remove() are not written immediately. Instead, the scope records
+ * the change, reflects it in subsequent lookups, and writes all pending changes to the database in
+ * a single bulk write when commit() is called. Changes that have not been committed when the
+ * unit_of_work is destroyed are discarded.
+ *
+ * A unit_of_work is not thread-safe and is intended to be used for the duration of a single
+ * request or task.
+ *
+ * @tparam T The model class whose objects are tracked. Must derive from model<T, IdType>.
+ * @tparam IdType The type of the model's _id field.
+ */
+template <typename T, typename IdType = bsoncxx::oid>
+class unit_of_work {
+   public:
+    unit_of_work() = default;
+
+    unit_of_work(const unit_of_work&) = delete;
+    unit_of_work& operator=(const unit_of_work&) = delete;
+
+    unit_of_work(unit_of_work&&) = default;
+    unit_of_work& operator=(unit_of_work&&) = default;
+
+    /**
+     * Finds a single object matching the provided filter.
+     *
+     * If the filter is a plain lookup by _id (i.e. {_id: <value>}) and that _id has already been
+     * looked up, saved or removed through this scope, the result is answered from memory. Any
+     * other filter is sent to the database, but if the matching document is already tracked, the
+     * tracked instance is returned instead of the freshly loaded one so that pending changes are
+     * not lost.
+     *
+     * @param filter
+     *   Document view representing a document that should match the query.
+     * @param options
+     *   Optional arguments, see mongocxx::options::find. Lookups that specify a projection always
+     *   go to the database and are not tracked, since the result is only a partial object. Each
+     *   such lookup returns a separate, untracked object.
+     *
+     * @return A pointer to the object that matched the filter, or nullptr if no object matched or
+     *         the matching object was removed through this scope. The pointer remains valid until
+     *         clear() is called or the unit_of_work is destroyed.
+     * @throws mongocxx::exception::query if the operation fails.
+     */
+    T* find_one(bsoncxx::document::view_or_value filter,
+                const mongocxx::options::find& options = mongocxx::options::find()) {
+        if (options.projection()) {
+            auto result = model<T, IdType>::find_one(std::move(filter), options);
+            if (!result) {
+                return nullptr;
+            }
+
+            _untracked.push_back(std::move(*result));
+            return &_untracked.back();
+        }
+
+        auto by_id = details::id_filter_from_query(filter.view());
+        if (by_id) {
+            auto key = details::id_key(by_id->view());
+            auto it = _entries.find(key);
+            if (it != _entries.end()) {
+                return get(it->second);
+            }
+
+            auto& e = _entries[key];
+            e.obj = model<T, IdType>::find_one(by_id->view(), options);
+            return get(e);
+        }
+
+        auto result = model<T, IdType>::find_one(std::move(filter), options);
+        if (!result) {
+            return nullptr;
+        }
+
+        return get(track(std::move(*result), state::clean, false));
+    }
+
+    /**
+     * Finds the object with the given _id, consulting the objects tracked by this scope first.
+     *
+     * @param id The _id of the object to look up.
+     *
+     * @return A pointer to the tracked object, or nullptr if no such object exists.
+     * @throws mongocxx::exception::query if the operation fails.
+     */
+    T* find_by_id(const IdType& id) {
+        return find_one(details::id_filter(id));
+    }
+
+    /**
+     * Records that the given object should be saved when this unit of work is committed.
+     *
+     * If the object is not already tracked, a copy of it is added to this scope and becomes the
+     * instance returned by subsequent lookups of its _id. If a different instance with the same
+     * _id is already tracked, it is overwritten by the given object.
+     *
+     * @param obj The object to save.
+     *
+     * @return A reference to the tracked instance.
+     */
+    T& save(const T& obj) {
+        return *get(track(obj, state::dirty, true));
+    }
+
+    /**
+     * Records that the given object should be removed when this unit of work is committed.
+     * Subsequent lookups of its _id through this scope will find nothing.
+     *
+     * @param obj The object to remove.
+     */
+    void remove(const T& obj) {
+        auto& e = _entries[key_of(obj)];
+        e.obj = mongocxx::stdx::nullopt;
+        e.st = state::removed;
+    }
+
+    /**
+     * Writes every pending save and removal to the database using a single bulk write. Saves are
+     * performed the same way as model::save(), i.e. as an upserting $set of the object in dotted
+     * notation.
+     *
+     * @param options
+     *   Optional arguments, see mongocxx::options::bulk_write.
+     *
+     * @return The result of the bulk write, or an empty optional if there was nothing to write or
+     *         the write was unacknowledged.
+     * @throws mongocxx::exception::bulk_write if the write fails. The pending changes are kept in
+     *         that case, so that commit() can be retried.
+     */
+    mongocxx::stdx::optional<mongocxx::result::bulk_write> commit(
+        const mongocxx::options::bulk_write& options = mongocxx::options::bulk_write()) {
+        using bsoncxx::builder::basic::kvp;
+
+        auto coll = model<T, IdType>::collection();
+        auto bulk = coll.create_bulk_write(options);
+        bool has_writes = false;
+
+        for (const auto& kv : _entries) {
+            const auto& e = kv.second;
+            auto filter = bsoncxx::document::view{
+                reinterpret_cast<const std::uint8_t*>(kv.first.data()), kv.first.size()};
+
+            if (e.st == state::dirty) {
+                auto update = bsoncxx::builder::basic::make_document(
+                    kvp("$set", boson::to_dotted_notation_document(*e.obj)));
+                mongocxx::model::update_one op{filter, update.view()};
+                op.upsert(true);
+                bulk.append(op);
+                has_writes = true;
+            } else if (e.st == state::removed) {
+                bulk.append(mongocxx::model::delete_one{filter});
+                has_writes = true;
+            }
+        }
+
+        if (!has_writes) {
+            return {};
+        }
+
+        auto result = bulk.execute();
+
+        for (auto& kv : _entries) {
+            if (kv.second.st != state::clean) {
+                model<T, IdType>::invalidate_cached_id(kv.first);
+                kv.second.st = state::clean;
+            }
+        }
+
+        return result;
+    }
+
+    /**
+     * Discards every tracked object and pending change. Pointers previously returned by this
+     * scope are invalidated.
+     */
+    void clear() {
+        _entries.clear();
+        _untracked.clear();
+    }
+
+    /**
+     * Returns the number of _ids tracked by this scope, including ones that were looked up but
+     * not found and ones that were removed.
+     */
+    std::size_t size() const {
+        return _entries.size();
+    }
+
+    /**
+     * Returns whether this scope has changes that have not been committed yet.
+     */
+    bool has_pending_changes() const {
+        for (const auto& kv : _entries) {
+            if (kv.second.st != state::clean) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+   private:
+    enum class state { clean, dirty, removed };
+
+    struct entry {
+        mongocxx::stdx::optional<T> obj;
+        state st = state::clean;
+    };
+
+    static std::string key_of(const T& obj) {
+        const auto& id = static_cast<const model<T, IdType>&>(obj)._id;
+        return details::id_key(details::id_filter(id).view());
+    }
+
+    static T* get(entry& e) {
+        return e.obj ? &*e.obj : nullptr;
+    }
+
+    /**
+     * Adds obj to the map. If its _id is already tracked, the existing instance wins unless
+     * overwrite is set, in which case it is replaced by obj. An _id that was previously looked up
+     * and not found is filled in with obj.
+     */
+    template <typename U>
+    entry& track(U&& obj, state st, bool overwrite) {
+        auto key = key_of(obj);
+        auto it = _entries.find(key);
+        if (it == _entries.end()) {
+            auto& e = _entries[key];
+            e.obj = std::forward<U>(obj);
+            e.st = st;
+            return e;
+        }
+
+        auto& e = it->second;
+        if (overwrite || (!e.obj && e.st == state::clean)) {
+            if (!e.obj || &*e.obj != &obj) {
+                e.obj = std::forward<U>(obj);
+            }
+            e.st = st;
+        }
+        return e;
+    }
+
+    std::unordered_map<std::string, entry> _entries;
+
+    // Holds the results of projected lookups, which are never tracked. A deque keeps the pointers
+    // returned for earlier results valid as more are added.
+    std::deque<T> _untracked;
+};
+
+MANGROVE_INLINE_NAMESPACE_END
+}  // namespace mangrove
+
+#include <mangrove/config/postlude.hpp>
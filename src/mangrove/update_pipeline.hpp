@@ -0,0 +1,400 @@
+// Copyright 2016 MongoDB Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <mangrove/config/prelude.hpp>
+
+#include <initializer_list>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <bsoncxx/array/value.hpp>
+#include <bsoncxx/builder/core.hpp>
+#include <bsoncxx/types.hpp>
+#include <bsoncxx/types/value.hpp>
+#include <mongocxx/pipeline.hpp>
+
+#include <mangrove/nvp.hpp>
+#include <mangrove/pipeline_builder.hpp>
+#include <mangrove/query_builder.hpp>
+#include <mangrove/util.hpp>
+
+namespace mangrove {
+MANGROVE_INLINE_NAMESPACE_BEGIN
+
+/**
+ * An aggregation expression, as used in the stages of an update pipeline. It is implicitly
+ * created from
+ *  - a name-value pair, which refers to the value of that field, e.g. "$price",
+ *  - a number or boolean, which is used as is,
+ *  - any other value, which is used as a {$literal: value}, so that strings starting with $ are
+ *    not mistaken for field paths.
+ * More complex expressions are built with the functions in mangrove::agg.
+ */
+class agg_expr {
+   public:
+    template <typename NvpT,
+              typename = std::enable_if_t<is_nvp_v<NvpT> && !is_free_nvp_v<NvpT>>>
+    agg_expr(const NvpT& field) : agg_expr(field_value(field)) {
+    }
+
+    template <typename T, typename = std::enable_if_t<std::is_arithmetic<T>::value>,
+              typename = void>
+    agg_expr(T value) : agg_expr(literal_value(value, false)) {
+    }
+
+    template <typename T,
+              typename = std::enable_if_t<!std::is_arithmetic<T>::value && !is_nvp_v<T> &&
+                                          !std::is_same<T, agg_expr>::value>,
+              typename = void, typename = void>
+    agg_expr(const T& value) : agg_expr(literal_value(value, true)) {
+    }
+
+    /**
+     * Creates an expression from a raw BSON value, for operators not covered by mangrove::agg.
+     */
+    static agg_expr from_value(const bsoncxx::types::value& value) {
+        auto builder = bsoncxx::builder::core(true);
+        builder.append(value);
+        return agg_expr{builder.extract_array()};
+    }
+
+    /**
+     * Appends this expression as the next value of a BSON core builder.
+     */
+    void append_to_bson(bsoncxx::builder::core& builder) const {
+        builder.append(_value.view()[0].get_value());
+    }
+
+   private:
+    // The expression is stored as the only element of an array.
+    explicit agg_expr(bsoncxx::array::value value) : _value(std::move(value)) {
+    }
+
+    template <typename NvpT>
+    static bsoncxx::array::value field_value(const NvpT& field) {
+        auto builder = bsoncxx::builder::core(true);
+        builder.append(details::field_path(field));
+        return builder.extract_array();
+    }
+
+    template <typename T>
+    static bsoncxx::array::value literal_value(const T& value, bool wrap) {
+        auto builder = bsoncxx::builder::core(true);
+        if (wrap) {
+            builder.open_document();
+            builder.key_view("$literal");
+            append_value_to_bson(value, builder);
+            builder.close_document();
+        } else {
+            append_value_to_bson(value, builder);
+        }
+        return builder.extract_array();
+    }
+
+    bsoncxx::array::value _value;
+};
+
+namespace details {
+
+// Builds the expression {op: [args...]}.
+inline agg_expr agg_operator(const char* op, std::initializer_list<agg_expr> args) {
+    auto builder = bsoncxx::builder::core(true);
+    builder.open_document();
+    builder.key_view(op);
+    builder.open_array();
+    for (const auto& arg : args) {
+        arg.append_to_bson(builder);
+    }
+    builder.close_array();
+    builder.close_document();
+    return agg_expr::from_value(builder.view_array()[0].get_value());
+}
+
+// Builds the expression {op: arg}.
+inline agg_expr agg_unary_operator(const char* op, const agg_expr& arg) {
+    auto builder = bsoncxx::builder::core(true);
+    builder.open_document();
+    builder.key_view(op);
+    arg.append_to_bson(builder);
+    builder.close_document();
+    return agg_expr::from_value(builder.view_array()[0].get_value());
+}
+
+// Builds the expression {op: {input: ..., as: ..., <key>: ...}} used by $filter and $map.
+inline agg_expr agg_array_operator(const char* op, const agg_expr& input, const std::string& as,
+                                   const char* key, const agg_expr& value) {
+    auto builder = bsoncxx::builder::core(true);
+    builder.open_document();
+    builder.key_view(op);
+    builder.open_document();
+    builder.key_view("input");
+    input.append_to_bson(builder);
+    builder.key_view("as");
+    builder.append(as);
+    builder.key_view(key);
+    value.append_to_bson(builder);
+    builder.close_document();
+    builder.close_document();
+    return agg_expr::from_value(builder.view_array()[0].get_value());
+}
+
+}  // namespace details
+
+/**
+ * Functions that build aggregation expressions over name-value pairs, e.g.
+ * agg::multiply(MANGROVE_KEY(Item::price), MANGROVE_KEY(Item::quantity)).
+ */
+namespace agg {
+
+/* Arithmetic operators */
+
+template <typename... Args>
+agg_expr add(const agg_expr& a, const agg_expr& b, const Args&... rest) {
+    return details::agg_operator("$add", {a, b, agg_expr(rest)...});
+}
+
+inline agg_expr subtract(const agg_expr& a, const agg_expr& b) {
+    return details::agg_operator("$subtract", {a, b});
+}
+
+template <typename... Args>
+agg_expr multiply(const agg_expr& a, const agg_expr& b, const Args&... rest) {
+    return details::agg_operator("$multiply", {a, b, agg_expr(rest)...});
+}
+
+inline agg_expr divide(const agg_expr& a, const agg_expr& b) {
+    return details::agg_operator("$divide", {a, b});
+}
+
+inline agg_expr mod(const agg_expr& a, const agg_expr& b) {
+    return details::agg_operator("$mod", {a, b});
+}
+
+/* Comparison and boolean operators */
+
+inline agg_expr eq(const agg_expr& a, const agg_expr& b) {
+    return details::agg_operator("$eq", {a, b});
+}
+
+inline agg_expr ne(const agg_expr& a, const agg_expr& b) {
+    return details::agg_operator("$ne", {a, b});
+}
+
+inline agg_expr gt(const agg_expr& a, const agg_expr& b) {
+    return details::agg_operator("$gt", {a, b});
+}
+
+inline agg_expr gte(const agg_expr& a, const agg_expr& b) {
+    return details::agg_operator("$gte", {a, b});
+}
+
+inline agg_expr lt(const agg_expr& a, const agg_expr& b) {
+    return details::agg_operator("$lt", {a, b});
+}
+
+inline agg_expr lte(const agg_expr& a, const agg_expr& b) {
+    return details::agg_operator("$lte", {a, b});
+}
+
+template <typename... Args>
+agg_expr and_(const agg_expr& a, const agg_expr& b, const Args&... rest) {
+    return details::agg_operator("$and", {a, b, agg_expr(rest)...});
+}
+
+template <typename... Args>
+agg_expr or_(const agg_expr& a, const agg_expr& b, const Args&... rest) {
+    return details::agg_operator("$or", {a, b, agg_expr(rest)...});
+}
+
+inline agg_expr not_(const agg_expr& a) {
+    return details::agg_operator("$not", {a});
+}
+
+/* Conditional operators */
+
+/**
+ * {$cond: [condition, then, otherwise]}
+ */
+inline agg_expr cond(const agg_expr& condition, const agg_expr& then, const agg_expr& otherwise) {
+    return details::agg_operator("$cond", {condition, then, otherwise});
+}
+
+/**
+ * {$ifNull: [value, replacement]}, i.e. the replacement if the value is null or missing.
+ */
+inline agg_expr if_null(const agg_expr& value, const agg_expr& replacement) {
+    return details::agg_operator("$ifNull", {value, replacement});
+}
+
+/* Array operators */
+
+/**
+ * The sum of the numbers in an array, e.g. sum(MANGROVE_KEY(Order::items)->*
+ * MANGROVE_KEY(Item::price)) for the total price of the items of an order.
+ */
+inline agg_expr sum(const agg_expr& array) {
+    return details::agg_unary_operator("$sum", array);
+}
+
+inline agg_expr avg(const agg_expr& array) {
+    return details::agg_unary_operator("$avg", array);
+}
+
+inline agg_expr min(const agg_expr& array) {
+    return details::agg_unary_operator("$min", array);
+}
+
+inline agg_expr max(const agg_expr& array) {
+    return details::agg_unary_operator("$max", array);
+}
+
+inline agg_expr size(const agg_expr& array) {
+    return details::agg_unary_operator("$size", array);
+}
+
+/**
+ * {$in: [value, array]}, i.e. whether the array contains the value.
+ */
+inline agg_expr in(const agg_expr& value, const agg_expr& array) {
+    return details::agg_operator("$in", {value, array});
+}
+
+template <typename... Args>
+agg_expr concat_arrays(const agg_expr& a, const agg_expr& b, const Args&... rest) {
+    return details::agg_operator("$concatArrays", {a, b, agg_expr(rest)...});
+}
+
+/**
+ * The elements of an array for which a condition holds. The condition refers to the current
+ * element through var(as), e.g.
+ * filter(MANGROVE_KEY(Order::items), "item", gt(var("item", MANGROVE_KEY(Item::price)), 10)).
+ */
+inline agg_expr filter(const agg_expr& input, const std::string& as, const agg_expr& condition) {
+    return details::agg_array_operator("$filter", input, as, "cond", condition);
+}
+
+/**
+ * The array obtained by applying an expression to every element of an array. The expression
+ * refers to the current element through var(as).
+ */
+inline agg_expr map(const agg_expr& input, const std::string& as, const agg_expr& in) {
+    return details::agg_array_operator("$map", input, as, "in", in);
+}
+
+/**
+ * Refers to a variable, such as the current element in filter() and map(), i.e. "$$name".
+ */
+inline agg_expr var(const std::string& name) {
+    auto builder = bsoncxx::builder::core(true);
+    builder.append("$$" + name);
+    return agg_expr::from_value(builder.view_array()[0].get_value());
+}
+
+/**
+ * Refers to a field of a variable holding a document, i.e. "$$name.field".
+ */
+template <typename NvpT, typename = std::enable_if_t<is_nvp_v<NvpT>>>
+agg_expr var(const std::string& name, const NvpT& field) {
+    std::string path = "$$" + name + ".";
+    auto builder = bsoncxx::builder::core(true);
+    builder.append(field.append_name(path));
+    return agg_expr::from_value(builder.view_array()[0].get_value());
+}
+
+}  // namespace agg
+
+/**
+ * Builds an update made of aggregation stages, which computes the new values of fields from the
+ * current values of the document, in a single server-side update. Requires MongoDB 4.2.
+ *
+ * Example, which stores the total price of the items of every order:
+ *
+ *     update_pipeline update;
+ *     update.set(MANGROVE_KEY(Order::total),
+ *                agg::sum(agg::map(MANGROVE_KEY(Order::items), "item",
+ *                                  agg::multiply(agg::var("item", MANGROVE_KEY(Item::price)),
+ *                                                agg::var("item", MANGROVE_KEY(Item::qty))))));
+ *     Order::update_many({}, update);
+ *
+ * model::update_one() and model::update_many() accept an update_pipeline when the driver
+ * supports pipeline updates (mongocxx 3.5 or later). With older drivers, pipeline() can be sent
+ * with the update command instead.
+ */
+class update_pipeline {
+   public:
+    /**
+     * Appends a $set stage, which sets a field to the value of an expression.
+     */
+    template <typename NvpT, typename = std::enable_if_t<is_nvp_v<NvpT>>>
+    update_pipeline& set(const NvpT& field, const agg_expr& value) {
+        std::string name;
+        auto builder = bsoncxx::builder::core(false);
+        builder.key_view("$set");
+        builder.open_document();
+        builder.key_owned(field.append_name(name));
+        value.append_to_bson(builder);
+        builder.close_document();
+        _pipeline.append_stage(builder.view_document());
+        return *this;
+    }
+
+    /**
+     * Appends an $unset stage, which removes the given fields.
+     */
+    template <typename... NvpTs,
+              typename = std::enable_if_t<all_true<is_nvp_v<NvpTs>...>::value>>
+    update_pipeline& unset(const NvpTs&... fields) {
+        auto builder = bsoncxx::builder::core(false);
+        builder.key_view("$unset");
+        builder.open_array();
+        tuple_for_each(std::forward_as_tuple(fields...), [&](const auto& field) {
+            std::string name;
+            builder.append(field.append_name(name));
+        });
+        builder.close_array();
+        _pipeline.append_stage(builder.view_document());
+        return *this;
+    }
+
+    /**
+     * Appends a $replaceWith stage, which replaces the document with the value of an expression,
+     * e.g. an embedded document.
+     */
+    update_pipeline& replace_with(const agg_expr& document) {
+        auto builder = bsoncxx::builder::core(false);
+        builder.key_view("$replaceWith");
+        document.append_to_bson(builder);
+        _pipeline.append_stage(builder.view_document());
+        return *this;
+    }
+
+    /**
+     * Returns the stages built so far.
+     */
+    const mongocxx::pipeline& pipeline() const {
+        return _pipeline;
+    }
+
+   private:
+    mongocxx::pipeline _pipeline;
+};
+
+MANGROVE_INLINE_NAMESPACE_END
+}  // namespace mangrove
+
+#include <mangrove/config/postlude.hpp>
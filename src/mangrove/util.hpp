@@ -18,6 +18,7 @@
 
 #include <chrono>
 #include <ctime>
+#include <iterator>
 #include <string>
 #include <tuple>
 #include <type_traits>
@@ -208,6 +209,23 @@ struct iterator_of
 template <typename iterator_type, typename T>
 constexpr bool iterator_of_v = iterator_of<iterator_type, T>::value;
 
+/**
+ * Type trait that checks whether an iterator can be traversed more than once, and allows modifying
+ * the objects it points to.
+ *
+ * @tparam iterator_type The iterator being checked.
+ */
+template <typename iterator_type>
+struct is_mutable_forward_iterator
+    : public std::integral_constant<
+          bool,
+          std::is_base_of<std::forward_iterator_tag,
+                          typename std::iterator_traits<iterator_type>::iterator_category>::value &&
+              std::is_lvalue_reference<
+                  typename std::iterator_traits<iterator_type>::reference>::value &&
+              !std::is_const<std::remove_reference_t<
+                  typename std::iterator_traits<iterator_type>::reference>>::value> {};
+
 MANGROVE_INLINE_NAMESPACE_END
 }  // namespace mangrove
 
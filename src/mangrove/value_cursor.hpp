@@ -0,0 +1,205 @@
+// Copyright 2016 MongoDB Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <mangrove/config/prelude.hpp>
+
+#include <iterator>
+#include <string>
+
+#include <bsoncxx/builder/core.hpp>
+#include <bsoncxx/document/value.hpp>
+#include <bsoncxx/document/view.hpp>
+#include <bsoncxx/stdx/optional.hpp>
+#include <mongocxx/cursor.hpp>
+
+#include <boson/mapping_functions.hpp>
+#include <mangrove/util.hpp>
+
+namespace mangrove {
+MANGROVE_INLINE_NAMESPACE_BEGIN
+
+namespace details {
+
+/**
+ * Wraps a single value so that it can be deserialized from the field with the given name in a
+ * BSON document.
+ */
+template <typename T>
+struct value_holder {
+    const char* name;
+    T value;
+
+    template <class Archive>
+    void serialize(Archive& ar) {
+        ar(cereal::make_nvp(name, value));
+    }
+};
+
+/**
+ * Looks up the document that directly contains the field at the given dotted path. For instance,
+ * for the path "a.b.c", this returns the sub-document at "a.b".
+ *
+ * @param doc The document to search.
+ * @param path The dotted path of a field.
+ * @return The view of the containing document, or an empty optional if any of the intermediate
+ *         fields is missing or isn't a document.
+ */
+inline bsoncxx::stdx::optional<bsoncxx::document::view> find_parent(bsoncxx::document::view doc,
+                                                                     const std::string& path) {
+    std::string::size_type begin = 0;
+    for (auto dot = path.find('.'); dot != std::string::npos; dot = path.find('.', begin)) {
+        auto it = doc.find(bsoncxx::stdx::string_view{path.data() + begin, dot - begin});
+        if (it == doc.end() || it->type() != bsoncxx::type::k_document) {
+            return {};
+        }
+        doc = it->get_document().value;
+        begin = dot + 1;
+    }
+    return doc;
+}
+
+/**
+ * Builds the projection that selects only the field at the given dotted path.
+ */
+inline bsoncxx::document::value value_projection(const std::string& path) {
+    auto builder = bsoncxx::builder::core(false);
+    builder.key_owned(path);
+    builder.append(std::int32_t{1});
+    if (path != "_id") {
+        builder.key_view("_id");
+        builder.append(std::int32_t{0});
+    }
+    return builder.extract_document();
+}
+
+}  // namespace details
+
+/**
+ * A class that wraps a mongocxx::cursor and yields the value of a single field of each document,
+ * without deserializing the rest of the document.
+ *
+ * NOTE: Like deserializing_cursor, this skips documents in which the value cannot be
+ * deserialized, e.g. because the field is missing and T isn't an optional, or because the path
+ * crosses an array.
+ *
+ * @tparam T The type of the field.
+ */
+template <class T>
+class value_cursor {
+   public:
+    /**
+     * @param c The cursor of documents to read.
+     * @param path The dotted path of the field to read from each document.
+     */
+    value_cursor(mongocxx::cursor&& c, std::string path)
+        : _c(std::move(c)), _path(std::move(path)) {
+        auto dot = _path.rfind('.');
+        _key = dot == std::string::npos ? _path : _path.substr(dot + 1);
+    }
+
+    class iterator;
+
+    iterator begin() {
+        return iterator(_c.begin(), _c.end(), this);
+    }
+
+    iterator end() {
+        return iterator(_c.end(), _c.end(), this);
+    }
+
+   private:
+    // Extracts the field's value from a document.
+    bsoncxx::stdx::optional<T> extract(bsoncxx::document::view doc) const {
+        details::value_holder<T> holder{_key.c_str(), T{}};
+
+        auto parent = details::find_parent(doc, _path);
+        if (!parent) {
+            if (is_optional_v<T>) {
+                return holder.value;
+            }
+            return {};
+        }
+
+        try {
+            boson::to_obj(*parent, holder);
+        } catch (boson::Exception& e) {
+            return {};
+        }
+        return {std::move(holder.value)};
+    }
+
+    mongocxx::cursor _c;
+    std::string _path;
+    std::string _key;
+};
+
+template <class T>
+class value_cursor<T>::iterator : public std::iterator<std::input_iterator_tag, T> {
+   public:
+    iterator(mongocxx::cursor::iterator ci, mongocxx::cursor::iterator ci_end,
+             const value_cursor* parent)
+        : _ci(ci), _ci_end(ci_end), _parent(parent) {
+        skip_invalid_documents();
+    }
+
+    iterator& operator++() {
+        ++_ci;
+        _opt = mongocxx::stdx::nullopt;
+        skip_invalid_documents();
+        return *this;
+    }
+
+    void operator++(int) {
+        operator++();
+    }
+
+    bool operator==(const iterator& rhs) {
+        return _ci == rhs._ci;
+    }
+
+    bool operator!=(const iterator& rhs) {
+        return _ci != rhs._ci;
+    }
+
+    /**
+     * Returns the value of the field in the current document.
+     */
+    T operator*() {
+        return _opt.value();
+    }
+
+   private:
+    mongocxx::cursor::iterator _ci;
+    mongocxx::cursor::iterator _ci_end;
+    const value_cursor* _parent;
+    // The value of the field in the current document, if the cursor isn't exhausted.
+    mongocxx::stdx::optional<T> _opt;
+
+    void skip_invalid_documents() {
+        while (_ci != _ci_end) {
+            _opt = _parent->extract(*_ci);
+            if (_opt) {
+                return;
+            }
+            ++_ci;
+        }
+    }
+};
+
+MANGROVE_INLINE_NAMESPACE_END
+}  // namespace mangrove
+
+#include <mangrove/config/postlude.hpp>